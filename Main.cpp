@@ -1,9 +1,13 @@
 #include <hyprland/src/Compositor.hpp>
 #include <hyprland/src/devices/IKeyboard.hpp>
+#include <hyprland/src/devices/IPointer.hpp>
 #include <hyprland/src/managers/SeatManager.hpp>
+#include <hyprland/src/managers/KeybindManager.hpp>
+#include <hyprland/src/managers/input/InputManager.hpp>
 #include <hyprland/src/helpers/Monitor.hpp>
 #include <hyprland/src/plugins/PluginAPI.hpp>
 #include <hyprland/src/desktop/LayerSurface.hpp>
+#include <hyprland/src/render/Renderer.hpp>
 #include <hyprutils/string/VarList.hpp>
 #include <chrono>
 #include <thread>
@@ -12,15 +16,63 @@
 #include <regex>
 #include <format>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <xkbcommon/xkbcommon.h>
+#include <array>
 #include <atomic>
+#include <bitset>
+#include <deque>
+#include <cmath>
 #include <cstdarg>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "hotspots-state.h"
 
 extern "C" {
     #include <wayland-server.h>
 }
 
+// USDT probes under the hypr_hotspots provider, for perf, bpftrace and bcc
+// (see probes/). Configure with -DHYPR_HOTSPOTS_USDT=ON; each probe is a
+// single NOP until a tracer attaches. Every probe has a semaphore the tracer
+// raises while attached, so arguments that cost something to compute can be
+// guarded with HOTSPOTS_PROBE_ENABLED().
+#ifdef HYPR_HOTSPOTS_USDT
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define HOTSPOTS_PROBE(...) STAP_PROBEV(hypr_hotspots, __VA_ARGS__)
+#define HOTSPOTS_PROBE_SEMAPHORE(name) \
+    unsigned short hypr_hotspots_##name##_semaphore __attribute__((unused)) __attribute__((section(".probes")))
+#define HOTSPOTS_PROBE_ENABLED(name) __builtin_expect(hypr_hotspots_##name##_semaphore != 0, 0)
+#else
+#define HOTSPOTS_PROBE(...) do {} while (0)
+#define HOTSPOTS_PROBE_SEMAPHORE(name) static_assert(true)
+#define HOTSPOTS_PROBE_ENABLED(name) false
+#endif
+
+HOTSPOTS_PROBE_SEMAPHORE(pointer_event);
+HOTSPOTS_PROBE_SEMAPHORE(hit_test);
+HOTSPOTS_PROBE_SEMAPHORE(region_enter);
+HOTSPOTS_PROBE_SEMAPHORE(region_leave);
+HOTSPOTS_PROBE_SEMAPHORE(bar_transition);
+HOTSPOTS_PROBE_SEMAPHORE(timer_arm);
+HOTSPOTS_PROBE_SEMAPHORE(timer_fire);
+HOTSPOTS_PROBE_SEMAPHORE(timer_cancel);
+HOTSPOTS_PROBE_SEMAPHORE(pid_resolved);
+HOTSPOTS_PROBE_SEMAPHORE(signal_sent);
+HOTSPOTS_PROBE_SEMAPHORE(command_spawn);
+HOTSPOTS_PROBE_SEMAPHORE(command_exit);
+
 using namespace std::literals;
 using namespace Hyprutils::String;
 
@@ -29,737 +81,4079 @@ enum class ToggleMode
     Hover, Hold, Press
 };
 
-// Forward declare PluginState and global_plugin_state before WaybarRegion
+// Waybar only understands "toggle", so the plugin tracks what it asked for and
+// only considers a transition done once the compositor maps/unmaps the surface
+enum class BarState
+{
+    Hidden, Showing, Shown, Hiding
+};
+
+// When buffered cursor motion is hit-tested: on the next frame of the monitor
+// under the cursor, or on a fixed wall-clock interval
+enum class PointerSampling
+{
+    Frame, Interval
+};
+
+// Forward declare PluginState and global_plugin_state before HoverRegion
 struct PluginState;
 extern std::unique_ptr<PluginState> global_plugin_state;
 
-struct WaybarRegion
+void debug_log(const char* format, ...);
+void update_mouse(int32_t mx, int32_t my);
+std::string monitor_name_from_id(MONITORID monitor_id);
+
+// Timer on the compositor's wayland event loop, so callbacks run on the main
+// thread like every other hook instead of racing it from a detached thread
+struct LoopTimer
 {
-    std::string process_name;
-    int32_t x;
-    int32_t y;
-    int32_t width;
-    int32_t height;
-    bool visible = false;
-    
-    // Cache leave area expansion values
-    int32_t leave_expand_left = 0;
-    int32_t leave_expand_right = 0;
-    int32_t leave_expand_up = 0;
-    int32_t leave_expand_down = 0;
+    wl_event_source* source = nullptr;
+    std::function<void()> callback;
+    const char* name = "timer";  // For the timer probes
+    bool armed = false;
 
-    void toggle();
-    bool is_actually_visible() const;
-    
-    // Keep the simple method inline
-    bool is_in_enter_area(int32_t px, int32_t py) const {
-        return px >= x && px <= x + width && py >= y && py <= y + height;
+    void init(const char* timer_name, std::function<void()> fn) {
+        name = timer_name;
+        callback = std::move(fn);
+        if (!source && g_pCompositor && g_pCompositor->m_wlEventLoop) {
+            source = wl_event_loop_add_timer(g_pCompositor->m_wlEventLoop, &LoopTimer::on_fire, this);
+        }
     }
-    
-    // Just declare this method - implement it later
-    bool is_in_leave_area(int32_t px, int32_t py) const;
-    
-    // Update leave area cache from global config
-    void update_leave_area_cache();
-};
 
-struct CommandRegion
-{
-    std::string enter_command;
-    std::string leave_command; // Optional
-    int32_t x;
-    int32_t y;
-    int32_t width;
-    int32_t height;
-    
-    bool is_in_area(int32_t px, int32_t py) const {
-        return px >= x && px <= x + width && py >= y && py <= y + height;
+    void arm(int ms) {
+        if (!source) {
+            return;
+        }
+        armed = true;
+        HOTSPOTS_PROBE(timer_arm, name, ms);
+        // A delay of 0 disarms a wl timer, so fire on the next loop iteration instead
+        wl_event_source_timer_update(source, std::max(ms, 1));
     }
-    
-    void execute_enter_command() const {
-        if (!enter_command.empty()) {
-            std::thread([cmd = enter_command]() {
-                std::system(cmd.c_str());
-            }).detach();
+
+    void cancel() {
+        if (!source || !armed) {
+            return;
         }
+        armed = false;
+        HOTSPOTS_PROBE(timer_cancel, name);
+        wl_event_source_timer_update(source, 0);
     }
-    
-    void execute_leave_command() const {
-        if (!leave_command.empty()) {
-            std::thread([cmd = leave_command]() {
-                std::system(cmd.c_str());
-            }).detach();
+
+    void destroy() {
+        if (source) {
+            wl_event_source_remove(source);
+            source = nullptr;
+        }
+        armed = false;
+    }
+
+    static int on_fire(void* data) {
+        auto* timer = static_cast<LoopTimer*>(data);
+        timer->armed = false;
+        HOTSPOTS_PROBE(timer_fire, timer->name);
+        if (timer->callback) {
+            timer->callback();
         }
+        return 0;
     }
 };
 
-struct PluginState
+// Runs a shell command to completion; callers put it on a detached thread
+int run_shell_command(const std::string& command)
 {
-    HANDLE handle;
-    bool allow_show_waybar;
-    ToggleMode toggle_mode;
-    WaybarRegion* hovered_region;
-    std::optional<uint32_t> toggle_bind_keycode;
-    std::vector<std::vector<WaybarRegion>> monitor_regions;
-    std::unordered_map<std::string, uint32_t> keycode_cache;
-    
-    int hide_delay_ms;
-    std::atomic<bool> hide_timer_active{false};
-    std::atomic<bool> workspace_timer_active{false};  // New timer for workspace changes
-    std::atomic<uint64_t> timer_generation{0};  // Generation counter to invalidate old timers
-    std::mutex regions_mutex;
-    std::atomic<bool> toggle_in_progress{false};
-    
-    // Add tracking for previous leave area state
-    bool was_in_leave_area_last_frame = false;
-    bool was_in_enter_area_last_frame = false;
-
-    // New members for command regions
-    std::vector<std::vector<CommandRegion>> monitor_command_regions;
-    CommandRegion* hovered_command_region = nullptr;
+    HOTSPOTS_PROBE(command_spawn, command.c_str());
+    // Only timed while a tracer is attached
+    bool timed = HOTSPOTS_PROBE_ENABLED(command_exit);
+    [[maybe_unused]] auto start = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+    int status = std::system(command.c_str());
+    if (timed) {
+        HOTSPOTS_PROBE(command_exit, command.c_str(), status,
+            static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()));
+    }
+    return status;
+}
 
-    PluginState(HANDLE handle) : handle(handle) { reset(); }
+struct LatencyStats
+{
+    // Histogram upper bounds; the extra last bucket takes everything slower
+    static constexpr std::array<double, 8> bucket_bounds_ms{ 1, 2, 4, 8, 16, 33, 66, 125 };
 
-    void reset()
-    {
-        hovered_region = nullptr;
-        hovered_command_region = nullptr;
-        allow_show_waybar = true;
-        toggle_mode = ToggleMode::Hover;
-        toggle_bind_keycode = std::nullopt;
-        hide_delay_ms = 0;
-        was_in_leave_area_last_frame = false;
-        was_in_enter_area_last_frame = false;
-        
-        // Cancel any active timers
-        hide_timer_active = false;
-        workspace_timer_active = false;
-        timer_generation++; // Invalidate all existing timers
-    }
+    uint64_t count = 0;
+    double last_ms = 0.0;
+    double min_ms = 0.0;
+    double max_ms = 0.0;
+    double total_ms = 0.0;
+    std::array<uint64_t, bucket_bounds_ms.size() + 1> buckets{};
 
-    void initialize_timer_thread() {
-        // No longer needed - using simple thread-per-timer approach
-    }
+    void record(double ms) {
+        min_ms = count == 0 ? ms : std::min(min_ms, ms);
+        max_ms = std::max(max_ms, ms);
+        last_ms = ms;
+        total_ms += ms;
+        ++count;
 
-    void start_timer_thread() {
-        // No longer needed - using simple thread-per-timer approach
-    }
-    
-    void start_hide_timer() {
-        if (hide_delay_ms <= 0) {
-            hide_all_immediate();
-            return;
-        }
-        
-        // Cancel any existing timer and increment generation
-        hide_timer_active = false;
-        uint64_t current_generation = ++timer_generation;
-        
-        if (global_plugin_state) {
-            int64_t debug_enabled = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:debug")->getDataStaticPtr());
-            if (debug_enabled) {
-                FILE* debug_file = fopen("/tmp/hypr-hotspots.log", "a");
-                if (debug_file) {
-                    fprintf(debug_file, "Starting hide timer (%d ms) gen %lu\n", hide_delay_ms, current_generation);
-                    fflush(debug_file);
-                    fclose(debug_file);
-                }
-            }
-        }
-        
-        // Start new timer in detached thread
-        std::thread([this, current_generation]() {
-            hide_timer_active = true;
-            std::this_thread::sleep_for(std::chrono::milliseconds(hide_delay_ms));
-            
-            // Only execute if timer wasn't cancelled and generation is still current
-            if (hide_timer_active && timer_generation == current_generation) {
-                // Check debug at runtime within lambda
-                if (global_plugin_state) {
-                    int64_t debug_enabled = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:debug")->getDataStaticPtr());
-                    if (debug_enabled) {
-                        FILE* debug_file = fopen("/tmp/hypr-hotspots.log", "a");
-                        if (debug_file) {
-                            fprintf(debug_file, "Hide timer expired gen %lu - hiding waybar\n", current_generation);
-                            fflush(debug_file);
-                            fclose(debug_file);
-                        }
-                    }
-                }
-                hide_all_immediate();
-            } else {
-                // Check debug at runtime within lambda
-                if (global_plugin_state) {
-                    int64_t debug_enabled = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:debug")->getDataStaticPtr());
-                    if (debug_enabled) {
-                        FILE* debug_file = fopen("/tmp/hypr-hotspots.log", "a");
-                        if (debug_file) {
-                            fprintf(debug_file, "Hide timer gen %lu was cancelled (current gen: %lu)\n", current_generation, timer_generation.load());
-                            fflush(debug_file);
-                            fclose(debug_file);
-                        }
-                    }
-                }
-            }
-        }).detach();
-    }
-    
-    void cancel_hide_timer_if_active() {
-        hide_timer_active = false;
-    }
-    
-    void start_workspace_timer() {
-        if (hide_delay_ms <= 0) {
-            return;
-        }
-        
-        // Cancel any existing timers and increment generation
-        hide_timer_active = false;
-        workspace_timer_active = false;
-        uint64_t current_generation = ++timer_generation;
-        
-        if (global_plugin_state) {
-            int64_t debug_enabled = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:debug")->getDataStaticPtr());
-            if (debug_enabled) {
-                FILE* debug_file = fopen("/tmp/hypr-hotspots.log", "a");
-                if (debug_file) {
-                    fprintf(debug_file, "Starting workspace timer (1000 ms debounce) gen %lu\n", current_generation);
-                    fflush(debug_file);
-                    fclose(debug_file);
-                }
-            }
+        size_t bucket = 0;
+        while (bucket < bucket_bounds_ms.size() && ms > bucket_bounds_ms[bucket]) {
+            ++bucket;
         }
-        
-        // Start new workspace timer - this waits before starting the actual hide timer
-        std::thread([this, current_generation]() {
-            workspace_timer_active = true;
-            // Wait 1 second after workspace change before starting hide timer
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-            
-            // Only start hide timer if workspace timer wasn't cancelled and generation is still current
-            if (workspace_timer_active && timer_generation == current_generation) {
-                // Check debug at runtime within lambda
-                if (global_plugin_state) {
-                    int64_t debug_enabled = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:debug")->getDataStaticPtr());
-                    if (debug_enabled) {
-                        FILE* debug_file = fopen("/tmp/hypr-hotspots.log", "a");
-                        if (debug_file) {
-                            fprintf(debug_file, "Workspace timer expired gen %lu - starting hide timer\n", current_generation);
-                            fflush(debug_file);
-                            fclose(debug_file);
-                        }
-                    }
-                }
-                start_hide_timer();
-            } else {
-                // Check debug at runtime within lambda
-                if (global_plugin_state) {
-                    int64_t debug_enabled = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:debug")->getDataStaticPtr());
-                    if (debug_enabled) {
-                        FILE* debug_file = fopen("/tmp/hypr-hotspots.log", "a");
-                        if (debug_file) {
-                            fprintf(debug_file, "Workspace timer gen %lu was cancelled (current gen: %lu)\n", current_generation, timer_generation.load());
-                            fflush(debug_file);
-                            fclose(debug_file);
-                        }
-                    }
-                }
-            }
-        }).detach();
-    }
-    
-    void cancel_workspace_timer_if_active() {
-        workspace_timer_active = false;
+        ++buckets[bucket];
     }
-    
-    // Clean shutdown method for plugin exit
-    void shutdown() {
-        // Cancel any active timers
-        hide_timer_active = false;
-        workspace_timer_active = false;
-        timer_generation++; // Invalidate all existing timers
+
+    double average_ms() const {
+        return count ? total_ms / count : 0.0;
     }
-    
-private:
-    void hide_all_immediate() {
-        if (!g_pCompositor) {
-            return;
-        }
-        
-        // Use a separate try-lock to avoid potential deadlocks
-        std::unique_lock<std::mutex> lock(regions_mutex, std::try_to_lock);
-        if (!lock.owns_lock()) {
-            return; // Skip if we can't get the lock immediately
-        }
-        
-        for (auto& regions : monitor_regions) {
-            for (auto& region : regions) {
-                if (region.is_actually_visible()) {
-                    region.toggle();
-                }
+
+    // Upper bound of the bucket holding the given percentile, capped at the observed max
+    double percentile_ms(double percentile) const {
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < bucket_bounds_ms.size(); ++bucket) {
+            seen += buckets[bucket];
+            if (count && seen >= percentile / 100.0 * count) {
+                return std::min(bucket_bounds_ms[bucket], max_ms);
             }
         }
+        return max_ms;
     }
 };
 
-// Now define the global_plugin_state
-std::unique_ptr<PluginState> global_plugin_state;
+// Opt-in tracing into bounded per-thread ring buffers, dumped as Chrome
+// trace-event JSON (chrome://tracing, ui.perfetto.dev). Old events are
+// overwritten, so it is safe to leave on.
+struct TraceEvent
+{
+    const char* name = nullptr;  // Static strings only
+    char phase = 'i';            // 'X' = complete span, 'i' = instant
+    pid_t tid = 0;
+    uint64_t ts_ns = 0;
+    uint64_t dur_ns = 0;
+    int64_t arg = 0;
+    char detail[32] = {};
+};
 
-void try_update_hovered_region_state();
+struct TraceBuffer
+{
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    uint64_t written = 0;
+    uint64_t last_ts_ns = 0;
+};
 
-bool is_debug_enabled() {
-    if (!global_plugin_state) return false;
-    int64_t debug_enabled = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:debug")->getDataStaticPtr());
-    return debug_enabled != 0;
+struct Tracer
+{
+    static constexpr size_t max_buffers = 32;
+
+    std::atomic<bool> enabled{false};
+    std::atomic<size_t> capacity{4096};
+    std::mutex buffers_mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+
+    void record(const char* name, char phase, uint64_t ts_ns, uint64_t dur_ns, int64_t arg, std::string_view detail);
+    void clear();
+    bool dump(const std::string& path, std::string& error);
+
+private:
+    TraceBuffer* local_buffer();
+};
+
+extern Tracer tracer;
+
+inline uint64_t trace_ns(std::chrono::steady_clock::time_point tp)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
 }
 
-void debug_log(const char* format, ...) {
-    if (!is_debug_enabled()) return;
-    
-    FILE* debug_file = fopen("/tmp/hypr-hotspots.log", "a");
-    if (debug_file) {
-        va_list args;
-        va_start(args, format);
-        vfprintf(debug_file, format, args);
-        va_end(args);
-        fflush(debug_file);
-        fclose(debug_file);
-    }
+inline bool trace_enabled()
+{
+    return tracer.enabled.load(std::memory_order_relaxed);
 }
 
-void add_notification(std::string_view message)
+inline void trace_instant(const char* name, std::string_view detail = {}, int64_t arg = 0)
 {
-    // Only write to debug file if debug is enabled
-    if (!is_debug_enabled()) return;
-    
-    FILE* debug_file = fopen("/tmp/hypr-hotspots.log", "a");
-    if (debug_file) {
-        fprintf(debug_file, "[hypr-hotspots]: %s\n", message.data());
-        fflush(debug_file);
-        fclose(debug_file);
+    if (trace_enabled()) {
+        tracer.record(name, 'i', trace_ns(std::chrono::steady_clock::now()), 0, arg, detail);
     }
 }
 
-auto fetch_process_pid(std::string_view name) -> pid_t
+inline void trace_span(const char* name, std::chrono::steady_clock::time_point start, std::string_view detail = {}, int64_t arg = 0)
 {
-    std::string cmd = "pidof -s " + std::string(name);
-
-    char buf[512];
-    auto* pidof = popen(cmd.c_str(), "r");
-    fgets(buf, 512, pidof);
-    auto pid = strtoul(buf, nullptr, 10);
-    pclose(pidof);
-    return pid;
+    if (trace_enabled()) {
+        auto start_ns = trace_ns(start);
+        tracer.record(name, 'X', start_ns, trace_ns(std::chrono::steady_clock::now()) - start_ns, arg, detail);
+    }
 }
 
-bool WaybarRegion::is_actually_visible() const
+// Records a span covering its own lifetime; costs one relaxed load while tracing is off
+struct TraceScope
 {
-    if (!g_pCompositor || g_pCompositor->m_monitors.empty()) {
-        return false;
-    }
-    
-    for (auto& monitor : g_pCompositor->m_monitors) {
-        if (!monitor || monitor->m_layerSurfaceLayers.size() <= 2) {
-            continue;
+    const char* name;
+    std::string_view detail;
+    int64_t arg = 0;
+    uint64_t start_ns = 0;
+
+    TraceScope(const char* name, std::string_view detail = {}) : name(name), detail(detail) {
+        if (trace_enabled()) {
+            start_ns = trace_ns(std::chrono::steady_clock::now());
         }
-        
-        for (auto& layer : monitor->m_layerSurfaceLayers[2]) {
-            if (layer && layer->m_namespace == process_name) {
-                return true;
-            }
+    }
+
+    ~TraceScope() {
+        if (start_ns) {
+            tracer.record(name, 'X', start_ns, trace_ns(std::chrono::steady_clock::now()) - start_ns, arg, detail);
         }
     }
-    
-    return false;
-}
+};
 
-void WaybarRegion::toggle()
+// Small fixed pool for calls that can block (popen, /proc reads). A job runs on
+// a worker and returns a completion; completions run on the compositor thread
+// when the pool's eventfd fires on the wayland event loop, so plugin state is
+// still only ever touched from one thread.
+struct WorkerPool
 {
-    if (global_plugin_state->toggle_in_progress.exchange(true)) {
-        // Skip - toggle already in progress
-        return;
-    }
-    
-    auto pid = fetch_process_pid(process_name);
-    
-    if (pid <= 0) {
-        global_plugin_state->toggle_in_progress = false;
-        return;
+    using Completion = std::function<void()>;
+    using Job = std::function<Completion()>;
+
+    static constexpr size_t thread_count = 2;
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::pair<Job, std::chrono::steady_clock::time_point>> jobs;
+    std::vector<Completion> completions;
+    bool stopping = false;
+    int event_fd = -1;
+    wl_event_source* source = nullptr;
+
+    size_t max_queue_depth = 0;
+    uint64_t jobs_run = 0;        // Completions delivered, main thread only
+    LatencyStats queue_wait;      // Submit to a worker picking the job up, guarded by mutex
+    LatencyStats main_blocked;    // Main-thread time in calls that may block, main thread only
+
+    bool start();
+    void stop();
+    void submit(Job job);
+    size_t queue_depth();
+
+private:
+    void run_worker();
+    void run_completions();
+    static int on_ready(int fd, uint32_t mask, void* data);
+};
+
+// Adds the time of a main-thread call that may block (a syscall, a contended lock)
+struct BlockedScope
+{
+    LatencyStats& stats;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    explicit BlockedScope(LatencyStats& stats) : stats(stats) {}
+
+    ~BlockedScope() {
+        stats.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
     }
+};
 
-    kill(pid, SIGUSR1);    std::thread([]() {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        global_plugin_state->toggle_in_progress = false;
-    }).detach();
+// One refresh interval of a monitor, for work that should line up with its frames
+inline int frame_interval_ms(const PHLMONITOR& monitor)
+{
+    auto refresh_rate = monitor && monitor->m_refreshRate > 0 ? monitor->m_refreshRate : 60.f;
+    return static_cast<int>(std::ceil(1000.0 / refresh_rate));
 }
 
-auto keycode_from_name(const std::string& name) -> std::optional<uint32_t>
+enum class HotspotEventKind : uint8_t
 {
-    if (name.empty()) {
-        return {};
+    Enter = 1, Leave = 2, Show = 4, Hide = 8
+};
+
+// Streams region enter/leave and bar show/hide as "kind>>id,monitor,usec" lines
+// to local listeners. Events are batched and written once per frame from the
+// event loop and never block: a listener that stops reading has its backlog
+// coalesced to the latest state per region, and is dropped if that keeps growing.
+struct EventStream
+{
+    static constexpr size_t max_buffered_bytes = 16 * 1024;
+    static constexpr size_t max_coalesced = 256;
+
+    struct Event
+    {
+        HotspotEventKind kind;
+        std::string id;
+        std::string monitor;
+        uint64_t ts_us = 0;
+    };
+
+    struct Client
+    {
+        EventStream* stream = nullptr;
+        int fd = -1;
+        wl_event_source* source = nullptr;
+        std::string in;
+        std::string out;
+        uint8_t kinds = 0xff;                              // HotspotEventKind bits
+        std::vector<std::string> ids;                      // Empty = every region
+        std::unordered_map<std::string, Event> coalesced;  // Latest event per region while out is full
+
+        bool wants(const Event& event) const;
+    };
+
+    int listen_fd = -1;
+    wl_event_source* listen_source = nullptr;
+    std::string path;
+    std::vector<std::unique_ptr<Client>> clients;
+    std::vector<Event> batch;
+    LoopTimer flush_timer;  // Flushes the batch if no frame is rendered
+
+    uint64_t events_emitted = 0;
+    uint64_t events_sent = 0;
+    uint64_t events_coalesced = 0;
+    uint64_t clients_dropped = 0;
+
+    bool is_open() const {
+        return listen_fd >= 0;
     }
 
-    if (global_plugin_state->keycode_cache.find(name) != global_plugin_state->keycode_cache.end()) {
-        return global_plugin_state->keycode_cache.at(name);
+    bool open();
+    void close();
+    void emit(HotspotEventKind kind, std::string_view id, std::string_view monitor);
+    void flush();
+
+private:
+    void accept_clients();
+    void read_client(Client& client);
+    void write_client(Client& client);
+    void queue_for(Client& client, const Event& event);
+    void disconnect(Client& client);
+    void prune();
+    static int on_listen(int fd, uint32_t mask, void* data);
+    static int on_client(int fd, uint32_t mask, void* data);
+};
+
+// Publishes hover and bar state in shared memory (layout in hotspots-state.h).
+// Changes only ask for a publish; it runs once the event loop is idle, and
+// writes the block only if the snapshot differs from the last one.
+struct StateSnapshot
+{
+    int fd = -1;
+    std::string name;  // shm_open name
+    hotspots_state* block = nullptr;
+    hotspots_state published{};
+    wl_event_source* idle_source = nullptr;
+
+    uint64_t requests = 0;
+    uint64_t updates = 0;
+
+    bool is_open() const {
+        return block != nullptr;
     }
 
-    auto sym = xkb_keysym_from_name(name.data(), XKB_KEYSYM_CASE_INSENSITIVE);
+    bool open();
+    void close();
+    void request();
 
-    if (sym == XKB_KEY_NoSymbol) {
-        return std::nullopt;
+private:
+    void build(hotspots_state& next) const;
+    void publish();
+    static void on_idle(void* data);
+};
+
+// The bar a process/namespace shows on one output, driven by SIGUSR1 to the
+// client owning that output's layer surface. Regions pointing at the same bar
+// share an instance, so two regions can never each toggle it.
+struct WaybarInstance
+{
+    std::string process_name;
+    MONITORID monitor_id = -1;
+    pid_t pid = 0;           // Owner of the layer surface when it was last mapped
+    pid_t lookup_pid = 0;    // pidof result for the next toggle only, it may own another output
+    bool lookup_pending = false;
+    BarState state = BarState::Hidden;
+    bool want_visible = false;
+    int attempts = 0;
+    int pending_toggles = 0;  // SIGUSR1s sent whose map/unmap has not been seen yet
+    std::chrono::steady_clock::time_point transition_started;
+    std::chrono::steady_clock::time_point transition_deadline;
+
+    LatencyStats confirm_latency;
+    uint64_t timeouts = 0;
+    uint64_t retries = 0;
+
+    bool in_flight() const {
+        return state == BarState::Showing || state == BarState::Hiding;
     }
 
-    auto* keymap = g_pSeatManager->m_keyboard->m_xkbKeymap;
-    auto* xkb_state = g_pSeatManager->m_keyboard->m_xkbState;
-    auto keycode_min = xkb_keymap_min_keycode(keymap);
-    auto keycode_max = xkb_keymap_max_keycode(keymap);
+    // In flight, or a retry's map/unmap is still on its way after the first one confirmed
+    bool settling() const {
+        return in_flight() || pending_toggles > 0;
+    }
+
+    void request(bool visible);
+    void on_surface_mapped(const PHLLS& layer);
+    void on_surface_unmapped();
+    void on_deadline();
+    bool is_actually_visible() const;
+    PHLLS mapped_surface() const;
+    void remember_owner(const PHLLS& layer);
+
+private:
+    void drive();
+    void begin_transition(BarState next);
+    void complete_transition(BarState final_state);
+    pid_t resolve_pid();
+    void lookup_pid_async();
+    bool send_toggle();
+    void announce(BarState from, BarState to) const;
+    void set_state(BarState next);
+};
+
+// A toggle key, optionally with modifiers ("SUPER SHIFT, B"). The keysym is
+// fixed at parse time; the keycode follows the active keymap.
+struct KeyBind
+{
+    xkb_keysym_t keysym = XKB_KEY_NoSymbol;
+    uint32_t modmask = 0;
+    uint32_t keycode = 0;  // Evdev keycode under the current keymap, 0 = not on this keymap
+    bool held = false;     // The press matched, so the release counts
+
+    bool valid() const {
+        return keysym != XKB_KEY_NoSymbol;
+    }
+};
+
+// keysym -> keycode for the current keymap, plus a bitmap of every keycode some
+// bind resolves to so the keyPress hook can drop everything else with one lookup
+struct KeymapTable
+{
+    static constexpr size_t max_keycode = 768;  // KEY_MAX + 1
+
+    std::unordered_map<xkb_keysym_t, uint32_t> keycodes;
+    std::bitset<max_keycode> bound;
+
+    bool is_bound(uint32_t keycode) const {
+        return keycode < max_keycode && bound.test(keycode);
+    }
+
+    void rebuild();
+    void resolve(KeyBind& bind);
+};
+
+// When a region may fire, from its workspace/class/fullscreen rules. Only
+// evaluated when the workspace, focus or fullscreen state changes; the result
+// lands in RegionSet::active, which hit-testing masks with.
+struct ActivationRules
+{
+    struct WorkspaceMatch
+    {
+        std::string selector;  // ID, "name:NAME", "special" or "special:NAME"
+        bool negate = false;
+    };
+
+    struct ClassMatch
+    {
+        std::regex pattern;
+        bool negate = false;
+    };
+
+    std::vector<WorkspaceMatch> workspaces;
+    std::vector<ClassMatch> classes;
+    bool over_fullscreen = false;
+
+    static bool workspace_matches(const std::string& selector, const PHLWORKSPACE& workspace) {
+        if (!workspace) {
+            return false;
+        }
+        if (selector == "special") {
+            return workspace->m_isSpecialWorkspace;
+        }
+        if (selector.starts_with("special:")) {
+            return workspace->m_isSpecialWorkspace && workspace->m_name == selector;
+        }
+        if (selector.starts_with("name:")) {
+            return workspace->m_name == selector.substr(5);
+        }
+        return selector == std::to_string(workspace->m_id);
+    }
+
+    // Active when nothing negated matches and, if there are plain matches, one of them does
+    template <typename Match, typename Test>
+    static bool list_matches(const std::vector<Match>& matches, Test test) {
+        bool has_positive = false;
+        bool positive_hit = false;
+        for (auto& match : matches) {
+            bool hit = test(match);
+            if (match.negate && hit) {
+                return false;
+            }
+            if (!match.negate) {
+                has_positive = true;
+                positive_hit |= hit;
+            }
+        }
+        return !has_positive || positive_hit;
+    }
+
+    bool matches(const PHLWORKSPACE& workspace, const std::string& window_class, bool fullscreen) const {
+        if (fullscreen && !over_fullscreen) {
+            return false;
+        }
+        return list_matches(workspaces, [&](const WorkspaceMatch& match) { return workspace_matches(match.selector, workspace); })
+            && list_matches(classes, [&](const ClassMatch& match) { return std::regex_match(window_class, match.pattern); });
+    }
+};
+
+// How a region treats the lower-ranked regions under it
+enum class OverlapPolicy
+{
+    Exclusive,  // Regions below are not under the cursor
+    Through,    // Regions below are tested too
+    Hold        // Regions below keep whatever hover state they had
+};
+
+// A hover region: a rectangle with any mix of actions. The waybar and command
+// keywords are shorthands that fill in one action each.
+struct HoverRegion
+{
+    std::string name;
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    ActivationRules activation;
+    size_t slot = 0;  // Bit in RegionSet::active
+
+    // Higher first; ties keep config order
+    int priority = 0;
+    OverlapPolicy overlap = OverlapPolicy::Exclusive;
+
+    // Bar action: shows this output's bar on enter, hides it after leaving
+    std::string process_name;
+    WaybarInstance* bar = nullptr;
+
+    // Region-specific toggle key for the bar; regions without one follow toggle_bind
+    std::optional<KeyBind> bind;
+    bool allow_show = false;
+
+    // Command and dispatcher actions
+    std::string enter_command;
+    std::string leave_command;
+    std::string dispatch;  // "<dispatcher> <args>", run on enter
+
+    // Leave area expansion, cached from the config; zero for regions without a bar
+    int32_t leave_expand_left = 0;
+    int32_t leave_expand_right = 0;
+    int32_t leave_expand_up = 0;
+    int32_t leave_expand_down = 0;
+
+    bool has_bar() const {
+        return bar != nullptr;
+    }
+
+    // Whether anything happens on entering or leaving, other than the bar
+    bool has_enter_actions() const {
+        return !enter_command.empty() || !leave_command.empty() || !dispatch.empty();
+    }
+
+    void show() {
+        if (bar) {
+            bar->request(true);
+        }
+    }
+
+    void hide() {
+        if (bar) {
+            bar->request(false);
+        }
+    }
+
+    bool is_actually_visible() const {
+        return bar && bar->is_actually_visible();
+    }
+
+    bool allows_show() const;
+
+    bool is_in_enter_area(int32_t px, int32_t py) const {
+        return px >= x && px <= x + width && py >= y && py <= y + height;
+    }
+
+    // The area that keeps the region hovered once entered
+    bool is_in_leave_area(int32_t px, int32_t py) const;
+
+    // Update leave area cache from global config
+    void update_leave_area_cache();
+
+    void execute_enter_actions() const {
+        if (!enter_command.empty()) {
+            std::thread([cmd = enter_command]() {
+                run_shell_command(cmd);
+            }).detach();
+        }
+        if (!dispatch.empty()) {
+            HyprlandAPI::invokeHyprctlCommand("dispatch", dispatch);
+        }
+    }
+
+    void execute_leave_actions() const {
+        if (!leave_command.empty()) {
+            std::thread([cmd = leave_command]() {
+                run_shell_command(cmd);
+            }).detach();
+        }
+    }
+};
+
+// A region under the cursor on one monitor
+struct HoveredRegion
+{
+    HoverRegion* region = nullptr;
+    bool in_enter_area = false;
+    bool entered = false;  // Enter actions ran, so leave actions are due
+};
+
+enum class ActionKind
+{
+    Scroll, Button
+};
+
+// Scroll/button region: input inside it is summed over action_window and run
+// as one command, with {delta} replaced by the total and {count} by the events
+struct ActionRegion
+{
+    std::string name;
+    ActionKind kind = ActionKind::Scroll;
+    wl_pointer_axis axis = WL_POINTER_AXIS_VERTICAL_SCROLL;
+    uint32_t button = 0;
+    std::string command;
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    ActivationRules activation;
+    size_t slot = 0;
+
+    bool is_in_area(int32_t px, int32_t py) const {
+        return px >= x && px <= x + width && py >= y && py <= y + height;
+    }
+};
+
+// Every region, indexed by monitor ID. Runtime edits (hyprctl) are made on a
+// copy and swapped in whole, so a failing command never leaves a partial edit.
+struct RegionSet
+{
+    std::vector<std::vector<HoverRegion>> hover;
+    std::vector<std::vector<ActionRegion>> action;
+    uint32_t auto_name_counter = 0;
+
+    // Per monitor, indices into hover by priority: the single table update_mouse()
+    // walks. Rebuilt by recompute_active(); add() appends until then.
+    std::vector<std::vector<uint32_t>> hover_order;
+
+    // One bit per region slot, from each region's activation rules. Slots of
+    // removed regions stay unused until the next config reload.
+    std::vector<bool> active;
+
+    // Bumped whenever what a hit-test can match changes
+    uint64_t generation = 0;
+
+    bool is_active(size_t slot) const {
+        return slot < active.size() && active[slot];
+    }
+
+    // Re-evaluate every region's rules against each monitor's current workspace
+    void recompute_active() {
+        ++generation;
+        auto focused = g_pCompositor->m_lastWindow.lock();
+        auto window_class = focused ? focused->m_class : std::string{};
+        auto monitor_count = std::max(hover.size(), action.size());
+
+        for (size_t monitor_id = 0; monitor_id < monitor_count; ++monitor_id) {
+            auto monitor = g_pCompositor->getMonitorFromID(monitor_id);
+            auto workspace = monitor ? (monitor->m_activeSpecialWorkspace ? monitor->m_activeSpecialWorkspace : monitor->m_activeWorkspace) : nullptr;
+            bool fullscreen = workspace && workspace->m_hasFullscreenWindow;
+
+            auto apply = [&](auto& table) {
+                if (monitor_id >= table.size()) {
+                    return;
+                }
+                for (auto& region : table[monitor_id]) {
+                    active[region.slot] = monitor && region.activation.matches(workspace, window_class, fullscreen);
+                }
+            };
+            apply(hover);
+            apply(action);
+        }
+
+        compile_hover_order();
+    }
+
+    void compile_hover_order() {
+        hover_order.resize(hover.size());
+        for (size_t monitor_id = 0; monitor_id < hover.size(); ++monitor_id) {
+            auto& regions = hover[monitor_id];
+            auto& order = hover_order[monitor_id];
+            order.resize(regions.size());
+            for (uint32_t i = 0; i < order.size(); ++i) {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return regions[a].priority > regions[b].priority; });
+        }
+    }
+
+    // Whether a is walked after b; both must be on the same monitor
+    static bool ranks_below(const HoverRegion& a, const HoverRegion& b) {
+        return a.priority < b.priority || (a.priority == b.priority && &a > &b);
+    }
+
+    HoverRegion* find_hover(const std::string& name) {
+        for (auto& regions : hover) {
+            for (auto& region : regions) {
+                if (region.name == name) {
+                    return &region;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    ActionRegion* find_action(const std::string& name) {
+        for (auto& regions : action) {
+            for (auto& region : regions) {
+                if (region.name == name) {
+                    return &region;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    bool contains(const std::string& name) {
+        return find_hover(name) || find_action(name);
+    }
+
+    // Returns an error message, empty on success
+    template <typename Region>
+    std::string add(Region region, MONITORID monitor_id, std::vector<std::vector<Region>>& table, const char* prefix) {
+        if (monitor_id < 0) {
+            return "Invalid monitor.";
+        }
+
+        if (region.name.empty()) {
+            do {
+                region.name = std::string(prefix) + "-" + std::to_string(++auto_name_counter);
+            } while (contains(region.name));
+        }
+        else if (contains(region.name)) {
+            return "A region named `" + region.name + "` already exists.";
+        }
+
+        if (table.size() <= static_cast<size_t>(monitor_id)) {
+            table.resize(monitor_id + 1);
+        }
+        // Active until the next recompute_active()
+        region.slot = active.size();
+        active.push_back(true);
+        table[monitor_id].emplace_back(std::move(region));
+        return {};
+    }
+
+    std::string add(HoverRegion region, MONITORID monitor_id) {
+        auto prefix = !region.has_bar() ? "command" : region.has_enter_actions() ? "region" : "waybar";
+        auto error = add(std::move(region), monitor_id, hover, prefix);
+        if (error.empty()) {
+            // Unranked until the next recompute_active()
+            hover_order.resize(hover.size());
+            hover_order[monitor_id].push_back(hover[monitor_id].size() - 1);
+        }
+        return error;
+    }
+
+    std::string add(ActionRegion region, MONITORID monitor_id) {
+        auto prefix = region.kind == ActionKind::Scroll ? "scroll" : "button";
+        return add(std::move(region), monitor_id, action, prefix);
+    }
+
+    bool remove(const std::string& name) {
+        size_t removed = 0;
+        for (auto& regions : hover) {
+            removed += std::erase_if(regions, [&](const HoverRegion& region) { return region.name == name; });
+        }
+        for (auto& regions : action) {
+            removed += std::erase_if(regions, [&](const ActionRegion& region) { return region.name == name; });
+        }
+        if (removed > 0) {
+            compile_hover_order();
+        }
+        return removed > 0;
+    }
+
+    void clear() {
+        for (auto& regions : hover) {
+            regions.clear();
+        }
+        for (auto& regions : action) {
+            regions.clear();
+        }
+        for (auto& order : hover_order) {
+            order.clear();
+        }
+        active.clear();
+        auto_name_counter = 0;
+        ++generation;
+    }
+};
+
+// Hover state machine for one monitor. Each output keeps its own, so leaving
+// one monitor's leave area and entering another's region are separate events.
+struct MonitorHoverState
+{
+    std::vector<HoveredRegion> hovered;  // Walk order, usually zero or one entry
+    // Bar hysteresis, over the hovered regions that have a bar
+    bool was_in_leave_area = false;
+    bool was_in_enter_area = false;
+    std::optional<std::chrono::steady_clock::time_point> hide_deadline;
+    std::optional<std::chrono::steady_clock::time_point> reveal_deadline;  // Workspace-change reveal in progress
+};
+
+// Monitor-local rectangle around the last missed position that no active
+// region reaches. While the cursor stays inside it, on the same monitor and
+// region generation, update_mouse() has nothing to find.
+struct EmptyRect
+{
+    MONITORID monitor_id = -1;
+    uint64_t generation = 0;
+    int32_t left = 0;
+    int32_t top = 0;
+    int32_t right = -1;
+    int32_t bottom = -1;
+
+    bool contains(MONITORID monitor, uint64_t current_generation, int32_t px, int32_t py) const {
+        return monitor == monitor_id && current_generation == generation
+            && px >= left && px <= right && py >= top && py <= bottom;
+    }
+
+    // Shrink to leave out the box [x0, x1] x [y0, y1], which (px, py) is outside
+    // of, cutting along the axis with the wider gap so more room is kept
+    void exclude(int32_t px, int32_t py, int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+        if (x1 < left || x0 > right || y1 < top || y0 > bottom) {
+            return;
+        }
+        int32_t gap_x = px < x0 ? x0 - px : px > x1 ? px - x1 : 0;
+        int32_t gap_y = py < y0 ? y0 - py : py > y1 ? py - y1 : 0;
+        if (gap_x > 0 && gap_x >= gap_y) {
+            if (px < x0) {
+                right = x0 - 1;
+            }
+            else {
+                left = x1 + 1;
+            }
+        }
+        else if (py < y0) {
+            bottom = y0 - 1;
+        }
+        else {
+            top = y1 + 1;
+        }
+    }
+
+    void invalidate() {
+        monitor_id = -1;
+    }
+};
+
+struct PluginState
+{
+    HANDLE handle;
+    bool allow_show_waybar;
+    ToggleMode toggle_mode;
+    KeyBind toggle_bind;
+    KeymapTable keymap_table;
+    RegionSet regions;
+    
+    int hide_delay_ms;
+    std::mutex regions_mutex;
+    LoopTimer monitor_timer;  // Fires at the earliest per-monitor reveal or hide deadline
+
+    // Workspace-change reveals: a burst of switches on one monitor is one reveal
+    bool show_on_workspace_change = true;
+    int workspace_debounce_ms = 1000;
+    uint64_t reveals = 0;
+    uint64_t reveals_suppressed = 0;
+
+    // Indexed by monitor ID, like the region tables
+    std::vector<MonitorHoverState> monitor_hover;
+    MONITORID cursor_monitor = -1;
+    std::vector<HoveredRegion> next_hovered;  // Scratch for update_mouse(), kept for its capacity
+
+    // Negative-hit cache for update_mouse()
+    EmptyRect empty_rect;
+    uint64_t hit_tests = 0;            // Positions update_mouse() had to classify
+    uint64_t empty_rect_hits = 0;      // ...answered by empty_rect without a scan
+    uint64_t region_checks_saved = 0;  // Region bounds those scans would have tested
+
+    // Latest cursor position; mouseMove only writes here and the hit-test runs later
+    struct PointerSample
+    {
+        Vector2D pos;
+        bool dirty = false;
+        std::chrono::steady_clock::time_point since;  // First move not yet processed
+        MONITORID monitor = -1;
+    };
+    PointerSample pointer;
+    PointerSampling pointer_sampling = PointerSampling::Frame;
+    int pointer_interval_ms = 16;
+    LoopTimer pointer_timer;  // Interval mode, or stands in for a frame that never comes
+    std::array<LatencyStats, 2> pointer_latency;  // Event to action, indexed by PointerSampling
+    uint64_t pointer_events = 0;
+    uint64_t pointer_updates = 0;
+
+    // Input hooks are only registered while something can fire. Idle means no
+    // pointer hook at all, so fullscreen or hotspots toggled off cost nothing.
+    SP<HOOK_CALLBACK_FN> mouse_move_hook;
+    SP<HOOK_CALLBACK_FN> mouse_axis_hook;
+    SP<HOOK_CALLBACK_FN> mouse_button_hook;
+    SP<HOOK_CALLBACK_FN> key_press_hook;
+    bool pointer_regions_live = false;  // An active command region, or an active waybar region allowed to show
+    bool action_regions_live = false;
+    bool binds_live = false;            // A toggle key could change what an active region does
+    std::unordered_set<uint32_t> consumed_buttons;  // Pressed over a button region, so their releases are swallowed too
+    bool idle = true;
+    uint64_t idle_transitions = 0;
+    uint64_t wake_transitions = 0;
+
+    // Bar state machines, keyed by "namespace@output". Never erased, so regions
+    // can hold plain pointers to them across config reloads.
+    std::unordered_map<std::string, WaybarInstance> waybar_instances;
+    LoopTimer transition_timer;  // Fires at the earliest pending show/hide deadline
+    int transition_timeout_ms = 300;
+    int transition_retries = 2;
+
+    SP<SHyprCtlCommand> hyprctl_command;
+    EventStream event_stream;
+    StateSnapshot state_snapshot;
+    WorkerPool workers;
+
+    // Bars mapped while tracing, waiting for the first frame that contains them
+    struct PendingBarFrame
+    {
+        MONITORID monitor;
+        std::chrono::steady_clock::time_point mapped_at;
+        std::string process_name;
+    };
+    std::vector<PendingBarFrame> pending_bar_frames;
+    MONITORID rendering_monitor = -1;
+
+    // Scroll/button input waiting to be run as one action, keyed by region name
+    struct PendingAction
+    {
+        std::string command;
+        double value = 0.0;
+        uint32_t events = 0;
+        std::chrono::steady_clock::time_point deadline;
+    };
+    std::unordered_map<std::string, PendingAction> pending_actions;
+    LoopTimer action_timer;
+    int action_window_ms = 50;
+    int action_max_inflight = 2;
+    // Shared with the command threads, which may outlive the plugin
+    std::shared_ptr<std::atomic<int>> actions_in_flight = std::make_shared<std::atomic<int>>(0);
+    uint64_t action_events = 0;
+    uint64_t actions_run = 0;
+    uint64_t actions_deferred = 0;
+
+    PluginState(HANDLE handle) : handle(handle) { reset(); }
+
+    void reset()
+    {
+        allow_show_waybar = true;
+        toggle_mode = ToggleMode::Hover;
+        toggle_bind = KeyBind{};
+        hide_delay_ms = 0;
+        monitor_hover.clear();
+        cursor_monitor = -1;
+        empty_rect.invalidate();
+
+        // Cancel any active timers
+        monitor_timer.cancel();
+    }
+
+    MonitorHoverState& hover_state(MONITORID monitor_id) {
+        if (monitor_hover.size() <= static_cast<size_t>(monitor_id)) {
+            monitor_hover.resize(monitor_id + 1);
+        }
+        return monitor_hover[monitor_id];
+    }
+
+    // Forget what is hovered; pending hides still run
+    void clear_hover_state() {
+        for (auto& hover : monitor_hover) {
+            hover.hovered.clear();
+            hover.was_in_leave_area = false;
+            hover.was_in_enter_area = false;
+        }
+        empty_rect.invalidate();
+        state_snapshot.request();
+    }
+
+    void initialize_timers() {
+        monitor_timer.init("monitor", [this]() {
+            check_monitor_deadlines();
+        });
+
+        transition_timer.init("transition", [this]() {
+            check_transition_deadlines();
+        });
+
+        action_timer.init("action", [this]() {
+            flush_actions();
+        });
+
+        pointer_timer.init("pointer", [this]() {
+            process_pointer();
+        });
+    }
+
+    void start_hide_timer(MONITORID monitor_id) {
+        if (hide_delay_ms <= 0) {
+            hide_monitor_immediate(monitor_id);
+            return;
+        }
+
+        // Re-arming replaces any pending deadline for this monitor
+        debug_log("Starting hide timer for monitor %ld (%d ms)\n", (long)monitor_id, hide_delay_ms);
+        hover_state(monitor_id).hide_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(hide_delay_ms);
+        arm_monitor_timer();
+    }
+
+    void cancel_hide_timer_if_active(MONITORID monitor_id) {
+        if (static_cast<size_t>(monitor_id) >= monitor_hover.size() || !monitor_hover[monitor_id].hide_deadline) {
+            return;
+        }
+        debug_log("Hide timer cancelled for monitor %ld\n", (long)monitor_id);
+        monitor_hover[monitor_id].hide_deadline.reset();
+        arm_monitor_timer();
+    }
+
+    // Every change to a reveal or hide deadline ends up here
+    void arm_monitor_timer() {
+        state_snapshot.request();
+        std::optional<std::chrono::steady_clock::time_point> earliest;
+        for (auto& hover : monitor_hover) {
+            for (auto& deadline : { hover.reveal_deadline, hover.hide_deadline }) {
+                if (deadline && (!earliest || *deadline < *earliest)) {
+                    earliest = deadline;
+                }
+            }
+        }
+
+        if (!earliest) {
+            monitor_timer.cancel();
+            return;
+        }
+
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(*earliest - std::chrono::steady_clock::now());
+        monitor_timer.arm(static_cast<int>(remaining.count()));
+    }
+
+    void check_monitor_deadlines() {
+        auto now = std::chrono::steady_clock::now();
+        for (size_t monitor_id = 0; monitor_id < monitor_hover.size(); ++monitor_id) {
+            auto& hover = monitor_hover[monitor_id];
+            if (hover.reveal_deadline && *hover.reveal_deadline <= now) {
+                hover.reveal_deadline.reset();
+                // The cursor sitting in a leave area keeps the bars, like any other hover
+                if (!hover.was_in_leave_area) {
+                    debug_log("Workspace reveal over on monitor %zu - starting hide timer\n", monitor_id);
+                    start_hide_timer(monitor_id);
+                }
+            }
+            if (hover.hide_deadline && *hover.hide_deadline <= now) {
+                hover.hide_deadline.reset();
+                debug_log("Hide timer expired - hiding waybar on monitor %zu\n", monitor_id);
+                hide_monitor_immediate(monitor_id);
+            }
+        }
+        arm_monitor_timer();
+    }
+
+    // Show a monitor's bars after its workspace changed, and start hiding them once
+    // switching has been quiet for workspace_debounce_ms. Switches during a reveal
+    // only push its deadline back, so a burst costs one round of show requests.
+    void reveal_monitor(MONITORID monitor_id) {
+        if (!show_on_workspace_change || hide_delay_ms <= 0 || monitor_id < 0) {
+            return;
+        }
+
+        auto& hover = hover_state(monitor_id);
+        hover.hide_deadline.reset();
+        if (hover.reveal_deadline) {
+            ++reveals_suppressed;
+        }
+        else {
+            ++reveals;
+            debug_log("Workspace changed - revealing waybar on monitor %ld\n", (long)monitor_id);
+            std::lock_guard<std::mutex> lock(regions_mutex);
+            if (static_cast<size_t>(monitor_id) < regions.hover.size()) {
+                for (auto& region : regions.hover[monitor_id]) {
+                    if (region.has_bar() && regions.is_active(region.slot)) {
+                        region.show();
+                    }
+                }
+            }
+        }
+
+        hover.reveal_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(workspace_debounce_ms);
+        arm_monitor_timer();
+    }
+
+    void on_pointer_moved(const Vector2D& pos) {
+        ++pointer_events;
+        if (HOTSPOTS_PROBE_ENABLED(pointer_event)) {
+            auto monitor = g_pCompositor->getMonitorFromVector(pos);
+            HOTSPOTS_PROBE(pointer_event, static_cast<int32_t>(pos.x), static_cast<int32_t>(pos.y), static_cast<int64_t>(monitor ? monitor->m_id : -1));
+        }
+        if (pos.x == pointer.pos.x && pos.y == pointer.pos.y) {
+            return;
+        }
+        schedule_pointer(pos);
+    }
+
+    // Queues a hit-test at pos for the next frame or interval tick, even if the
+    // cursor has not moved since the last one
+    void schedule_pointer(const Vector2D& pos) {
+        pointer.pos = pos;
+        if (pointer.dirty) {
+            return;
+        }
+        pointer.dirty = true;
+        pointer.since = std::chrono::steady_clock::now();
+
+        if (pointer_sampling == PointerSampling::Interval) {
+            pointer_timer.arm(pointer_interval_ms);
+            return;
+        }
+
+        // Wait for the next frame on the monitor under the cursor. A hardware cursor
+        // moves without rendering anything, so the timer stands in for its vblank.
+        auto monitor = g_pCompositor->getMonitorFromVector(pos);
+        pointer.monitor = monitor ? monitor->m_id : -1;
+        pointer_timer.arm(frame_interval_ms(monitor));
+    }
+
+    void on_monitor_frame(MONITORID monitor_id) {
+        if (pointer.dirty && pointer_sampling == PointerSampling::Frame && monitor_id == pointer.monitor) {
+            process_pointer();
+        }
+    }
+
+    void process_pointer() {
+        if (!pointer.dirty) {
+            return;
+        }
+        pointer.dirty = false;
+        pointer_timer.cancel();
+        ++pointer_updates;
+
+        TraceScope trace("pointer update", pointer_sampling == PointerSampling::Frame ? "frame" : "interval");
+        update_mouse(static_cast<int32_t>(pointer.pos.x), static_cast<int32_t>(pointer.pos.y));
+
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pointer.since);
+        pointer_latency[static_cast<size_t>(pointer_sampling)].record(elapsed.count());
+
+        // Leaving the last hovered region may be all that kept the pointer hook alive
+        if (!pointer_regions_live) {
+            update_hooks();
+        }
+    }
+
+    void refresh_activity();
+    void update_hooks();
+
+    static std::string waybar_instance_key(std::string_view process_name, std::string_view monitor_name) {
+        return std::string(process_name) + "@" + std::string(monitor_name);
+    }
+
+    WaybarInstance* waybar_instance(const std::string& process_name, const PHLMONITOR& monitor) {
+        auto [it, inserted] = waybar_instances.try_emplace(waybar_instance_key(process_name, monitor->m_name));
+        if (inserted) {
+            it->second.process_name = process_name;
+            it->second.monitor_id = monitor->m_id;
+            // Start from whatever the compositor currently shows
+            if (auto layer = it->second.mapped_surface()) {
+                it->second.remember_owner(layer);
+                it->second.state = BarState::Shown;
+            }
+            it->second.want_visible = it->second.state == BarState::Shown;
+        }
+        return &it->second;
+    }
+
+    // The instance behind a layer surface, if some region targets it
+    WaybarInstance* find_waybar_instance(const PHLLS& layer) {
+        auto monitor = layer ? layer->m_monitor.lock() : nullptr;
+        if (!monitor) {
+            return nullptr;
+        }
+        auto it = waybar_instances.find(waybar_instance_key(layer->m_namespace, monitor->m_name));
+        return it != waybar_instances.end() ? &it->second : nullptr;
+    }
+
+    void arm_transition_timer() {
+        std::optional<std::chrono::steady_clock::time_point> earliest;
+        for (auto& [name, instance] : waybar_instances) {
+            if (instance.settling() && (!earliest || instance.transition_deadline < *earliest)) {
+                earliest = instance.transition_deadline;
+            }
+        }
+
+        if (!earliest) {
+            transition_timer.cancel();
+            return;
+        }
+
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(*earliest - std::chrono::steady_clock::now());
+        transition_timer.arm(static_cast<int>(remaining.count()));
+    }
+
+    void check_transition_deadlines() {
+        auto now = std::chrono::steady_clock::now();
+        for (auto& [name, instance] : waybar_instances) {
+            if (instance.settling() && instance.transition_deadline <= now) {
+                instance.on_deadline();
+            }
+        }
+        arm_transition_timer();
+    }
+    
+    void trace_bar_frames(MONITORID monitor) {
+        std::erase_if(pending_bar_frames, [monitor](const PendingBarFrame& pending) {
+            if (pending.monitor != monitor) {
+                return false;
+            }
+            trace_span("map to first frame", pending.mapped_at, pending.process_name, monitor);
+            return true;
+        });
+    }
+
+    void queue_action(const ActionRegion& region, double value) {
+        ++action_events;
+        auto [it, inserted] = pending_actions.try_emplace(region.name);
+        auto& pending = it->second;
+        pending.value += value;
+        ++pending.events;
+
+        if (inserted) {
+            // The first event opens the window; everything until the deadline joins it
+            pending.command = region.command;
+            pending.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(action_window_ms);
+            arm_action_timer();
+        }
+    }
+
+    void arm_action_timer() {
+        std::optional<std::chrono::steady_clock::time_point> earliest;
+        for (auto& [name, pending] : pending_actions) {
+            if (!earliest || pending.deadline < *earliest) {
+                earliest = pending.deadline;
+            }
+        }
+
+        if (!earliest) {
+            action_timer.cancel();
+            return;
+        }
+
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(*earliest - std::chrono::steady_clock::now());
+        action_timer.arm(static_cast<int>(remaining.count()));
+    }
+
+    void flush_actions() {
+        auto now = std::chrono::steady_clock::now();
+        for (auto it = pending_actions.begin(); it != pending_actions.end();) {
+            auto& pending = it->second;
+            if (pending.deadline > now) {
+                ++it;
+                continue;
+            }
+
+            // Too many still running: keep summing into the same action and try again next window
+            if (*actions_in_flight >= action_max_inflight) {
+                ++actions_deferred;
+                pending.deadline = now + std::chrono::milliseconds(action_window_ms);
+                ++it;
+                continue;
+            }
+
+            run_action(expand_action_command(pending));
+            it = pending_actions.erase(it);
+        }
+        arm_action_timer();
+    }
+
+    static std::string expand_action_command(const PendingAction& pending) {
+        char value[32];
+        snprintf(value, sizeof(value), "%g", pending.value);
+
+        auto command = pending.command;
+        for (auto [placeholder, replacement] : { std::pair<std::string_view, std::string>{ "{delta}", value }, { "{count}", std::to_string(pending.events) } }) {
+            for (auto pos = command.find(placeholder); pos != std::string::npos; pos = command.find(placeholder, pos + replacement.size())) {
+                command.replace(pos, placeholder.size(), replacement);
+            }
+        }
+        return command;
+    }
+
+    void run_action(std::string command) {
+        ++actions_run;
+        ++*actions_in_flight;
+        debug_log("Running action: %s\n", command.c_str());
+        std::thread([in_flight = actions_in_flight, cmd = std::move(command)]() {
+            run_shell_command(cmd);
+            --*in_flight;
+        }).detach();
+    }
+
+    // Re-resolve every bind against the keymap table, optionally rebuilding it first
+    void refresh_keybinds(bool rebuild_table) {
+        if (rebuild_table) {
+            keymap_table.rebuild();
+        }
+
+        keymap_table.bound.reset();
+        if (toggle_bind.valid()) {
+            keymap_table.resolve(toggle_bind);
+        }
+        for (auto& monitor_regions : regions.hover) {
+            for (auto& region : monitor_regions) {
+                if (region.bind) {
+                    keymap_table.resolve(*region.bind);
+                }
+            }
+        }
+    }
+
+    // Swap in an edited copy of the region set. Hover state follows regions by
+    // name; a region that disappeared under the cursor is treated as left.
+    void replace_regions(RegionSet staged) {
+        // Copies, since the removed regions go away with the old set
+        struct LeftRegion
+        {
+            MONITORID monitor_id;
+            HoverRegion region;
+            bool entered;
+        };
+
+        std::vector<std::vector<std::pair<std::string, HoveredRegion>>> hovered_names(monitor_hover.size());
+        std::vector<LeftRegion> left_regions;
+        for (size_t monitor_id = 0; monitor_id < monitor_hover.size(); ++monitor_id) {
+            for (auto& entry : monitor_hover[monitor_id].hovered) {
+                if (staged.find_hover(entry.region->name)) {
+                    hovered_names[monitor_id].emplace_back(entry.region->name, entry);
+                }
+                else {
+                    left_regions.push_back({ static_cast<MONITORID>(monitor_id), *entry.region, entry.entered });
+                }
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(regions_mutex);
+            regions = std::move(staged);
+            regions.recompute_active();
+            for (size_t monitor_id = 0; monitor_id < monitor_hover.size(); ++monitor_id) {
+                auto& hover = monitor_hover[monitor_id];
+                hover.hovered.clear();
+                for (auto& [name, entry] : hovered_names[monitor_id]) {
+                    entry.region = regions.find_hover(name);
+                    hover.hovered.push_back(entry);
+                }
+            }
+        }
+
+        for (size_t monitor_id = 0; monitor_id < monitor_hover.size(); ++monitor_id) {
+            auto& hover = monitor_hover[monitor_id];
+            bool bar_hovered = std::any_of(hover.hovered.begin(), hover.hovered.end(), [](const HoveredRegion& entry) { return entry.region->has_bar(); });
+            if (!bar_hovered && hover.was_in_leave_area) {
+                hover.was_in_leave_area = false;
+                hover.was_in_enter_area = false;
+                start_hide_timer(monitor_id);
+            }
+        }
+
+        for (auto& left : left_regions) {
+            if (left.entered) {
+                debug_log("Removed hovered region %s - running leave actions\n", left.region.name.c_str());
+                left.region.execute_leave_actions();
+            }
+            HOTSPOTS_PROBE(region_leave, left.region.name.c_str(), static_cast<int64_t>(left.monitor_id));
+            event_stream.emit(HotspotEventKind::Leave, left.region.name, monitor_name_from_id(left.monitor_id));
+        }
+
+        state_snapshot.request();
+        refresh_keybinds(false);
+        refresh_activity();
+
+        // A region may have been added under, or moved out from under, a cursor
+        // that is not moving
+        if (g_pInputManager) {
+            schedule_pointer(g_pInputManager->getMouseCoordsInternal());
+        }
+    }
+
+    // Clean shutdown method for plugin exit
+    void shutdown() {
+        // First, so no completion runs against state that is being torn down
+        workers.stop();
+        // Timers live on the compositor's event loop and must not outlive the plugin
+        monitor_timer.destroy();
+        transition_timer.destroy();
+        action_timer.destroy();
+        pointer_timer.destroy();
+        event_stream.close();
+        state_snapshot.close();
+        mouse_move_hook.reset();
+        mouse_axis_hook.reset();
+        mouse_button_hook.reset();
+        key_press_hook.reset();
+    }
+    
+private:
+    void hide_monitor_immediate(MONITORID monitor_id) {
+        if (!g_pCompositor) {
+            return;
+        }
+
+        // Use a separate try-lock to avoid potential deadlocks
+        std::unique_lock<std::mutex> lock(regions_mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            return; // Skip if we can't get the lock immediately
+        }
+
+        if (monitor_id < 0 || static_cast<size_t>(monitor_id) >= regions.hover.size()) {
+            return;
+        }
+
+        // Regions only point at bars on their own output, so the others are untouched
+        for (auto& region : regions.hover[monitor_id]) {
+            region.hide();
+        }
+    }
+};
+
+// Now define the global_plugin_state
+std::unique_ptr<PluginState> global_plugin_state;
+
+void try_update_hovered_region_state();
+
+bool is_debug_enabled() {
+    if (!global_plugin_state) return false;
+    int64_t debug_enabled = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:debug")->getDataStaticPtr());
+    return debug_enabled != 0;
+}
+
+void debug_log(const char* format, ...) {
+    if (!is_debug_enabled()) return;
+    
+    FILE* debug_file = fopen("/tmp/hypr-hotspots.log", "a");
+    if (debug_file) {
+        va_list args;
+        va_start(args, format);
+        vfprintf(debug_file, format, args);
+        va_end(args);
+        fflush(debug_file);
+        fclose(debug_file);
+    }
+}
+
+void add_notification(std::string_view message)
+{
+    // Only write to debug file if debug is enabled
+    if (!is_debug_enabled()) return;
+    
+    FILE* debug_file = fopen("/tmp/hypr-hotspots.log", "a");
+    if (debug_file) {
+        fprintf(debug_file, "[hypr-hotspots]: %s\n", message.data());
+        fflush(debug_file);
+        fclose(debug_file);
+    }
+}
+
+void append_format(std::string& out, const char* format, ...)
+{
+    char buf[512];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len > 0) {
+        out.append(buf, std::min<size_t>(len, sizeof(buf) - 1));
+    }
+}
+
+std::string escape_json(std::string_view value)
+{
+    std::string out;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+Tracer tracer;
+
+// Threads keep a raw pointer to their buffer (no thread_local destructor, which
+// would pin the plugin in memory). Past max_buffers, the stalest buffer is
+// shared with the new thread; events carry their own tid so nothing is mislabelled.
+TraceBuffer* Tracer::local_buffer()
+{
+    thread_local TraceBuffer* local = nullptr;
+    if (local) {
+        return local;
+    }
+
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    if (buffers.size() < max_buffers) {
+        auto buffer = std::make_unique<TraceBuffer>();
+        buffer->events.resize(capacity.load());
+        local = buffer.get();
+        buffers.push_back(std::move(buffer));
+    }
+    else {
+        local = std::min_element(buffers.begin(), buffers.end(), [](auto& a, auto& b) { return a->last_ts_ns < b->last_ts_ns; })->get();
+    }
+    return local;
+}
+
+void Tracer::record(const char* name, char phase, uint64_t ts_ns, uint64_t dur_ns, int64_t arg, std::string_view detail)
+{
+    static thread_local pid_t tid = gettid();
+    auto* buffer = local_buffer();
+
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    if (buffer->events.empty()) {
+        return;
+    }
+
+    auto& event = buffer->events[buffer->written++ % buffer->events.size()];
+    event.name = name;
+    event.phase = phase;
+    event.tid = tid;
+    event.ts_ns = ts_ns;
+    event.dur_ns = dur_ns;
+    event.arg = arg;
+    auto len = std::min(detail.size(), sizeof(event.detail) - 1);
+    memcpy(event.detail, detail.data(), len);
+    event.detail[len] = '\0';
+    buffer->last_ts_ns = ts_ns;
+}
+
+void Tracer::clear()
+{
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    for (auto& buffer : buffers) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+        buffer->events.assign(capacity.load(), TraceEvent{});
+        buffer->written = 0;
+    }
+}
+
+bool Tracer::dump(const std::string& path, std::string& error)
+{
+    // Snapshot first so the buffers are not held while writing the file
+    std::vector<TraceEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        for (auto& buffer : buffers) {
+            std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+            auto size = buffer->events.size();
+            auto count = std::min<uint64_t>(buffer->written, size);
+            for (uint64_t i = buffer->written - count; i < buffer->written; ++i) {
+                events.push_back(buffer->events[i % size]);
+            }
+        }
+    }
+
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        error = std::string("failed to open ") + path + ": " + strerror(errno);
+        return false;
+    }
+
+    auto pid = getpid();
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"Hyprland (hypr-hotspots)\"}}", pid);
+    for (auto& event : events) {
+        fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"hotspots\",\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f",
+            event.name, event.phase, pid, event.tid, event.ts_ns / 1000.0);
+        if (event.phase == 'X') {
+            fprintf(file, ",\"dur\":%.3f", event.dur_ns / 1000.0);
+        }
+        else {
+            fprintf(file, ",\"s\":\"t\"");
+        }
+        fprintf(file, ",\"args\":{\"value\":%ld,\"detail\":\"%s\"}}", static_cast<long>(event.arg), escape_json(event.detail).c_str());
+    }
+    fprintf(file, "\n]}\n");
+
+    bool ok = fclose(file) == 0;
+    if (!ok) {
+        error = std::string("failed to write ") + path;
+    }
+    return ok;
+}
+
+const char* event_kind_name(HotspotEventKind kind)
+{
+    switch (kind) {
+    case HotspotEventKind::Enter: return "enter";
+    case HotspotEventKind::Leave: return "leave";
+    case HotspotEventKind::Show: return "show";
+    case HotspotEventKind::Hide: return "hide";
+    }
+    return "unknown";
+}
+
+bool EventStream::Client::wants(const Event& event) const
+{
+    if (!(kinds & static_cast<uint8_t>(event.kind))) {
+        return false;
+    }
+    return ids.empty() || std::find(ids.begin(), ids.end(), event.id) != ids.end();
+}
+
+// Next to Hyprland's own sockets: $XDG_RUNTIME_DIR/hypr/$HYPRLAND_INSTANCE_SIGNATURE/.hotspots.sock
+bool EventStream::open()
+{
+    if (is_open()) {
+        return true;
+    }
+
+    const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+    const char* signature = getenv("HYPRLAND_INSTANCE_SIGNATURE");
+    if (!runtime_dir || !g_pCompositor || !g_pCompositor->m_wlEventLoop) {
+        return false;
+    }
+
+    path = std::string(runtime_dir) + "/hypr" + (signature ? std::string("/") + signature : std::string{}) + "/.hotspots.sock";
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        debug_log("Event socket path too long: %s\n", path.c_str());
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        return false;
+    }
+
+    unlink(path.c_str());
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listen_fd, 8) < 0) {
+        debug_log("Failed to listen on %s: %s\n", path.c_str(), strerror(errno));
+        ::close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    listen_source = wl_event_loop_add_fd(g_pCompositor->m_wlEventLoop, listen_fd, WL_EVENT_READABLE, &EventStream::on_listen, this);
+    flush_timer.init("event flush", [this]() { flush(); });
+    debug_log("Event socket listening on %s\n", path.c_str());
+    return true;
+}
+
+void EventStream::close()
+{
+    for (auto& client : clients) {
+        disconnect(*client);
+    }
+    clients.clear();
+    batch.clear();
+    flush_timer.destroy();
+
+    if (listen_source) {
+        wl_event_source_remove(listen_source);
+        listen_source = nullptr;
+    }
+    if (listen_fd >= 0) {
+        ::close(listen_fd);
+        listen_fd = -1;
+        unlink(path.c_str());
+    }
+}
+
+void EventStream::emit(HotspotEventKind kind, std::string_view id, std::string_view monitor)
+{
+    // Nobody listening: nothing to format or keep
+    if (clients.empty()) {
+        return;
+    }
+
+    ++events_emitted;
+    auto now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch());
+    batch.push_back({ kind, std::string(id), std::string(monitor), static_cast<uint64_t>(now.count()) });
+
+    // Normally flushed by the next frame; the timer covers outputs that render nothing
+    if (batch.size() == 1) {
+        flush_timer.arm(frame_interval_ms(g_pCompositor->getMonitorFromCursor()));
+    }
+}
+
+void EventStream::flush()
+{
+    if (batch.empty()) {
+        return;
+    }
+    flush_timer.cancel();
+
+    for (auto& client : clients) {
+        for (auto& event : batch) {
+            queue_for(*client, event);
+        }
+        if (client->fd >= 0) {
+            write_client(*client);
+        }
+    }
+    batch.clear();
+    prune();
+}
+
+void EventStream::queue_for(Client& client, const Event& event)
+{
+    if (client.fd < 0 || !client.wants(event)) {
+        return;
+    }
+
+    // Backed up: keep only the newest enter/leave and show/hide per region until it drains
+    if (client.out.size() >= max_buffered_bytes || !client.coalesced.empty()) {
+        bool hover = event.kind == HotspotEventKind::Enter || event.kind == HotspotEventKind::Leave;
+        client.coalesced[event.id + '\0' + event.monitor + (hover ? "h" : "v")] = event;
+        ++events_coalesced;
+
+        if (client.coalesced.size() > max_coalesced) {
+            debug_log("Dropping event stream client %d: not reading\n", client.fd);
+            ++clients_dropped;
+            disconnect(client);
+        }
+        return;
+    }
+
+    append_format(client.out, "%s>>%s,%s,%lu\n", event_kind_name(event.kind), event.id.c_str(), event.monitor.c_str(), event.ts_us);
+    ++events_sent;
+}
+
+void EventStream::write_client(Client& client)
+{
+    while (true) {
+        while (!client.out.empty()) {
+            auto written = send(client.fd, client.out.data(), client.out.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (written <= 0) {
+                disconnect(client);
+                return;
+            }
+            client.out.erase(0, written);
+        }
+
+        if (!client.out.empty() || client.coalesced.empty()) {
+            break;
+        }
+
+        // Drained: replay what was coalesced in the meantime, oldest first
+        std::vector<Event> pending;
+        for (auto& [key, event] : client.coalesced) {
+            pending.push_back(std::move(event));
+        }
+        client.coalesced.clear();
+        std::sort(pending.begin(), pending.end(), [](const Event& a, const Event& b) { return a.ts_us < b.ts_us; });
+        for (auto& event : pending) {
+            queue_for(client, event);
+        }
+    }
+
+    // Only wake up for writability while there is something left to write
+    wl_event_source_fd_update(client.source, WL_EVENT_READABLE | (client.out.empty() ? 0 : WL_EVENT_WRITABLE));
+}
+
+// Listeners may send "filter [kind=enter,leave,show,hide] [region=NAME,...]";
+// a bare "filter" goes back to every event
+void EventStream::read_client(Client& client)
+{
+    char buf[512];
+    while (true) {
+        auto len = recv(client.fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (len <= 0) {
+            disconnect(client);
+            return;
+        }
+        client.in.append(buf, len);
+    }
+
+    for (auto newline = client.in.find('\n'); newline != std::string::npos; newline = client.in.find('\n')) {
+        auto line = client.in.substr(0, newline);
+        client.in.erase(0, newline + 1);
+
+        auto words = CVarList{ line, 0, ' ', true };
+        if (words.size() == 0 || words[0] != "filter") {
+            continue;
+        }
+
+        client.kinds = 0xff;
+        client.ids.clear();
+        for (size_t i = 1; i < words.size(); ++i) {
+            auto word = std::string(words[i]);
+            auto equals = word.find('=');
+            if (equals == std::string::npos) {
+                continue;
+            }
+
+            auto key = word.substr(0, equals);
+            auto values = CVarList{ word.substr(equals + 1), 0, ',', true };
+            if (key == "kind") {
+                client.kinds = 0;
+                for (auto& value : values) {
+                    for (auto kind : { HotspotEventKind::Enter, HotspotEventKind::Leave, HotspotEventKind::Show, HotspotEventKind::Hide }) {
+                        if (value == event_kind_name(kind)) {
+                            client.kinds |= static_cast<uint8_t>(kind);
+                        }
+                    }
+                }
+            }
+            else if (key == "region") {
+                for (auto& value : values) {
+                    client.ids.push_back(value);
+                }
+            }
+        }
+    }
+
+    // A client that only ever writes is not allowed to grow this forever
+    if (client.in.size() > 4096) {
+        disconnect(client);
+    }
+}
+
+void EventStream::accept_clients()
+{
+    while (true) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+
+        auto client = std::make_unique<Client>();
+        client->stream = this;
+        client->fd = fd;
+        client->source = wl_event_loop_add_fd(g_pCompositor->m_wlEventLoop, fd, WL_EVENT_READABLE, &EventStream::on_client, client.get());
+        clients.push_back(std::move(client));
+        debug_log("Event stream client connected (%zu total)\n", clients.size());
+    }
+}
+
+void EventStream::disconnect(Client& client)
+{
+    if (client.source) {
+        wl_event_source_remove(client.source);
+        client.source = nullptr;
+    }
+    if (client.fd >= 0) {
+        ::close(client.fd);
+        client.fd = -1;
+    }
+}
+
+void EventStream::prune()
+{
+    std::erase_if(clients, [](const std::unique_ptr<Client>& client) { return client->fd < 0; });
+}
+
+int EventStream::on_listen(int fd, uint32_t mask, void* data)
+{
+    static_cast<EventStream*>(data)->accept_clients();
+    return 0;
+}
+
+int EventStream::on_client(int fd, uint32_t mask, void* data)
+{
+    auto* client = static_cast<Client*>(data);
+    auto* stream = client->stream;
+
+    if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+        stream->disconnect(*client);
+    }
+    else {
+        if (mask & WL_EVENT_READABLE) {
+            stream->read_client(*client);
+        }
+        if ((mask & WL_EVENT_WRITABLE) && client->fd >= 0) {
+            stream->write_client(*client);
+        }
+    }
+
+    stream->prune();
+    return 0;
+}
+
+bool StateSnapshot::open()
+{
+    if (is_open()) {
+        return true;
+    }
+
+    const char* signature = getenv("HYPRLAND_INSTANCE_SIGNATURE");
+    name = std::string("/hypr-hotspots") + (signature ? std::string("-") + signature : std::string{});
+
+    fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0600);
+
+    // /dev/shm is world-writable and the name is easy to guess: only reuse a block
+    // we own that nobody else can write, otherwise start a fresh one
+    struct stat info {};
+    if (fd >= 0 && (fstat(fd, &info) != 0 || info.st_uid != geteuid() || (info.st_mode & (S_IWGRP | S_IWOTH)) != 0)) {
+        debug_log("State block %s is not ours alone - recreating it\n", name.c_str());
+        ::close(fd);
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+    }
+    if (fd < 0) {
+        debug_log("Failed to create state block %s: %s\n", name.c_str(), strerror(errno));
+        return false;
+    }
+
+    void* mapping = MAP_FAILED;
+    if (ftruncate(fd, sizeof(hotspots_state)) == 0) {
+        mapping = mmap(nullptr, sizeof(hotspots_state), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (mapping == MAP_FAILED) {
+        debug_log("Failed to map state block %s: %s\n", name.c_str(), strerror(errno));
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    block = static_cast<hotspots_state*>(mapping);
+
+    // A block left by an earlier load of the plugin is reused, so readers that
+    // still have it mapped keep working; its sequence keeps counting from there
+    std::atomic_ref<uint32_t> sequence(block->sequence);
+    auto current = sequence.load(std::memory_order_relaxed);
+    if (current & 1) {
+        sequence.store(current + 1, std::memory_order_release);
+    }
+    block->magic = HOTSPOTS_STATE_MAGIC;
+    block->version = HOTSPOTS_STATE_VERSION;
+    block->size = sizeof(hotspots_state);
+    memset(&published, 0, sizeof(published));
+
+    request();
+    debug_log("State snapshot published in /dev/shm%s\n", name.c_str());
+    return true;
+}
+
+void StateSnapshot::close()
+{
+    if (idle_source) {
+        wl_event_source_remove(idle_source);
+        idle_source = nullptr;
+    }
+    if (block) {
+        munmap(block, sizeof(hotspots_state));
+        block = nullptr;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+        shm_unlink(name.c_str());
+    }
+}
+
+// Something a reader can see may have changed
+void StateSnapshot::request()
+{
+    ++requests;
+    if (!block || idle_source || !g_pCompositor || !g_pCompositor->m_wlEventLoop) {
+        return;
+    }
+    idle_source = wl_event_loop_add_idle(g_pCompositor->m_wlEventLoop, &StateSnapshot::on_idle, this);
+}
+
+void StateSnapshot::build(hotspots_state& next) const
+{
+    auto& state = *global_plugin_state;
+    auto copy_name = [](char* dest, std::string_view src) {
+        memcpy(dest, src.data(), std::min(src.size(), size_t{ HOTSPOTS_STATE_NAME_SIZE - 1 }));
+    };
+    auto deadline_ns = [](const std::optional<std::chrono::steady_clock::time_point>& deadline) -> uint64_t {
+        return deadline ? std::chrono::duration_cast<std::chrono::nanoseconds>(deadline->time_since_epoch()).count() : 0;
+    };
+
+    next.magic = HOTSPOTS_STATE_MAGIC;
+    next.version = HOTSPOTS_STATE_VERSION;
+    next.size = sizeof(hotspots_state);
+    next.flags = (state.idle ? HOTSPOTS_STATE_IDLE : 0) | (state.allow_show_waybar ? HOTSPOTS_STATE_SHOW_ALLOWED : 0);
+    next.cursor_monitor = static_cast<int32_t>(state.cursor_monitor);
+
+    for (size_t monitor_id = 0; monitor_id < state.monitor_hover.size() && next.monitor_count < HOTSPOTS_STATE_MAX_MONITORS; ++monitor_id) {
+        auto& hover = state.monitor_hover[monitor_id];
+        auto& out = next.monitors[next.monitor_count++];
+        out.id = static_cast<int32_t>(monitor_id);
+        out.hovered_count = static_cast<uint32_t>(hover.hovered.size());
+        out.in_enter_area = hover.was_in_enter_area;
+        out.in_leave_area = hover.was_in_leave_area;
+        out.hide_deadline_ns = deadline_ns(hover.hide_deadline);
+        out.reveal_deadline_ns = deadline_ns(hover.reveal_deadline);
+        if (auto monitor = g_pCompositor->getMonitorFromID(monitor_id)) {
+            copy_name(out.name, monitor->m_name);
+        }
+        // Walk order, so the first is the region that won the overlap
+        if (!hover.hovered.empty()) {
+            copy_name(out.hovered, hover.hovered.front().region->name);
+        }
+    }
+
+    for (auto& [key, bar] : state.waybar_instances) {
+        if (next.bar_count == HOTSPOTS_STATE_MAX_BARS) {
+            break;
+        }
+        auto& out = next.bars[next.bar_count++];
+        out.monitor_id = static_cast<int32_t>(bar.monitor_id);
+        out.pid = bar.pid;
+        out.state = static_cast<uint32_t>(bar.state);
+        out.want_visible = bar.want_visible;
+        copy_name(out.name, key);
+    }
+}
+
+// Seqlock write: the sequence is odd while the payload changes, so a reader
+// that saw the same even value before and after its copy got a whole snapshot
+void StateSnapshot::publish()
+{
+    hotspots_state next;
+    memset(&next, 0, sizeof(next));
+    build(next);
+
+    next.sequence = published.sequence;
+    next.updated_ns = published.updated_ns;
+    if (memcmp(&next, &published, sizeof(next)) == 0) {
+        return;
+    }
+    next.updated_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    // Everything from updated_ns on is payload; the header fields before the sequence never change
+    constexpr size_t payload = offsetof(hotspots_state, updated_ns);
+    std::atomic_ref<uint32_t> sequence(block->sequence);
+    auto current = sequence.load(std::memory_order_relaxed);
+    sequence.store(current + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(reinterpret_cast<char*>(block) + payload, reinterpret_cast<const char*>(&next) + payload, sizeof(hotspots_state) - payload);
+    sequence.store(current + 2, std::memory_order_release);
+
+    next.sequence = current + 2;
+    published = next;
+    ++updates;
+}
+
+void StateSnapshot::on_idle(void* data)
+{
+    auto* snapshot = static_cast<StateSnapshot*>(data);
+    snapshot->idle_source = nullptr;
+    snapshot->publish();
+}
+
+bool WorkerPool::start()
+{
+    if (event_fd >= 0 || !g_pCompositor || !g_pCompositor->m_wlEventLoop) {
+        return event_fd >= 0;
+    }
+
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0) {
+        return false;
+    }
+    source = wl_event_loop_add_fd(g_pCompositor->m_wlEventLoop, event_fd, WL_EVENT_READABLE, &WorkerPool::on_ready, this);
+
+    stopping = false;
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads.emplace_back([this]() { run_worker(); });
+    }
+    return true;
+}
+
+// Waits for running jobs; their completions, and queued jobs, are dropped
+void WorkerPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        jobs.clear();
+    }
+    wake.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    completions.clear();
+
+    if (source) {
+        wl_event_source_remove(source);
+        source = nullptr;
+    }
+    if (event_fd >= 0) {
+        close(event_fd);
+        event_fd = -1;
+    }
+}
+
+void WorkerPool::submit(Job job)
+{
+    if (threads.empty()) {
+        // No pool (eventfd failed): run inline rather than lose the work
+        BlockedScope blocked(main_blocked);
+        if (auto completion = job()) {
+            completion();
+        }
+        return;
+    }
+
+    {
+        BlockedScope blocked(main_blocked);
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.emplace_back(std::move(job), std::chrono::steady_clock::now());
+        max_queue_depth = std::max(max_queue_depth, jobs.size());
+    }
+    wake.notify_one();
+}
+
+size_t WorkerPool::queue_depth()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs.size();
+}
+
+void WorkerPool::run_worker()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if (stopping) {
+            return;
+        }
+
+        auto [job, queued_at] = std::move(jobs.front());
+        jobs.pop_front();
+        queue_wait.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - queued_at).count());
+
+        lock.unlock();
+        auto completion = job();
+        lock.lock();
+
+        if (completion && !stopping) {
+            completions.push_back(std::move(completion));
+            uint64_t one = 1;
+            // Can only fail with EAGAIN once the counter is saturated, and then a
+            // wakeup is already pending for this completion too
+            [[maybe_unused]] auto written = write(event_fd, &one, sizeof(one));
+        }
+    }
+}
+
+void WorkerPool::run_completions()
+{
+    // Nothing to drain without a pending wakeup; a worker's write brings us back
+    uint64_t count = 0;
+    if (read(event_fd, &count, sizeof(count)) != sizeof(count)) {
+        return;
+    }
+
+    std::vector<Completion> ready;
+    {
+        BlockedScope blocked(main_blocked);
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(completions);
+    }
+
+    for (auto& completion : ready) {
+        ++jobs_run;
+        completion();
+    }
+}
+
+int WorkerPool::on_ready(int fd, uint32_t mask, void* data)
+{
+    static_cast<WorkerPool*>(data)->run_completions();
+    return 0;
+}
+
+auto fetch_process_pid(std::string_view name) -> pid_t
+{
+    TraceScope trace("resolve pid", name);
+    std::string cmd = "pidof -s " + std::string(name);
+
+    auto* pidof = popen(cmd.c_str(), "r");
+    if (!pidof) {
+        debug_log("Failed to run pidof for %.*s: %s\n", static_cast<int>(name.size()), name.data(), strerror(errno));
+        return 0;
+    }
+
+    char buf[512] = {};
+    bool read = fgets(buf, sizeof(buf), pidof) != nullptr;
+    pclose(pidof);
+    if (!read) {
+        // pidof prints nothing when no process matches
+        return 0;
+    }
+
+    // Anything but a plain positive pid means there is nothing to follow
+    char* end = nullptr;
+    errno = 0;
+    auto value = strtol(buf, &end, 10);
+    if (end == buf || errno != 0 || value <= 0 || value > std::numeric_limits<pid_t>::max()) {
+        return 0;
+    }
+
+    auto pid = static_cast<pid_t>(value);
+    trace.arg = pid;
+    return pid;
+}
+
+const char* bar_state_name(BarState state)
+{
+    switch (state) {
+    case BarState::Hidden: return "hidden";
+    case BarState::Showing: return "showing";
+    case BarState::Shown: return "shown";
+    case BarState::Hiding: return "hiding";
+    }
+    return "unknown";
+}
+
+// The bar's layer surface on its own output, if it is currently mapped
+PHLLS WaybarInstance::mapped_surface() const
+{
+    auto monitor = g_pCompositor ? g_pCompositor->getMonitorFromID(monitor_id) : nullptr;
+    if (!monitor || monitor->m_layerSurfaceLayers.size() <= 2) {
+        return nullptr;
+    }
+
+    for (auto& layer : monitor->m_layerSurfaceLayers[2]) {
+        // Unmapped surfaces linger in the list while they fade out
+        if (layer && layer->m_mapped && layer->m_namespace == process_name) {
+            return layer.lock();
+        }
+    }
+    return nullptr;
+}
+
+bool WaybarInstance::is_actually_visible() const
+{
+    return mapped_surface() != nullptr;
+}
+
+// A hidden bar has no surface to ask, so keep the owning client from the last map
+void WaybarInstance::remember_owner(const PHLLS& layer)
+{
+    auto resource = layer->m_surface ? layer->m_surface->resource() : nullptr;
+    auto* client = resource ? resource->client() : nullptr;
+    if (!client) {
+        return;
+    }
+
+    pid_t owner = 0;
+    wl_client_get_credentials(client, &owner, nullptr, nullptr);
+    if (owner > 0) {
+        pid = owner;
+    }
+}
+
+// Only answers from what is known without blocking; 0 means a lookup is needed
+pid_t WaybarInstance::resolve_pid()
+{
+    // Same span name as the pidof fallback, which only runs when this finds nothing
+    TraceScope trace("resolve pid", process_name);
+
+    if (auto layer = mapped_surface()) {
+        remember_owner(layer);
+    }
+
+    if (pid > 0) {
+        BlockedScope blocked(global_plugin_state->workers.main_blocked);
+        if (kill(pid, 0) == 0) {
+            if (HOTSPOTS_PROBE_ENABLED(pid_resolved)) {
+                HOTSPOTS_PROBE(pid_resolved, process_name.c_str(), pid, static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - blocked.start).count()), 0);
+            }
+            trace.arg = pid;
+            return pid;
+        }
+        pid = 0;
+    }
+    trace.arg = lookup_pid;
+    return std::exchange(lookup_pid, 0);
+}
+
+// Never seen mapped, or the bar was restarted while hidden. Any process with the
+// name will do, looked up off the compositor thread; the result is only used for
+// the next toggle since it may own another output.
+void WaybarInstance::lookup_pid_async()
+{
+    if (lookup_pending) {
+        return;
+    }
+    lookup_pending = true;
+
+    global_plugin_state->workers.submit([this, name = process_name, start = std::chrono::steady_clock::now()]() -> WorkerPool::Completion {
+        auto found = fetch_process_pid(name);
+        return [this, found, start]() {
+            lookup_pending = false;
+            if (HOTSPOTS_PROBE_ENABLED(pid_resolved)) {
+                HOTSPOTS_PROBE(pid_resolved, process_name.c_str(), found, static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()), 1);
+            }
+            if (found <= 0) {
+                debug_log("No process found for %s on monitor %ld - not toggling\n", process_name.c_str(), (long)monitor_id);
+                return;
+            }
+            lookup_pid = found;
+            drive();
+        };
+    });
+}
+
+bool WaybarInstance::send_toggle()
+{
+    auto target = resolve_pid();
+
+    if (target <= 0) {
+        lookup_pid_async();
+        return false;
+    }
+
+    TraceScope trace("kill", process_name);
+    trace.arg = target;
+    BlockedScope blocked(global_plugin_state->workers.main_blocked);
+    bool sent = kill(target, SIGUSR1) == 0;
+    HOTSPOTS_PROBE(signal_sent, process_name.c_str(), target, SIGUSR1, static_cast<int>(sent));
+    if (sent) {
+        ++pending_toggles;
+    }
+    return sent;
+}
+
+void WaybarInstance::request(bool visible)
+{
+    if (want_visible != visible) {
+        global_plugin_state->state_snapshot.request();
+    }
+    want_visible = visible;
+    drive();
+}
+
+// Send at most one toggle at a time; whatever is wanted once every toggle sent
+// has been seen to land gets picked up by the next call from there
+void WaybarInstance::drive()
+{
+    if (settling()) {
+        return;
+    }
+
+    if (want_visible && state == BarState::Hidden) {
+        begin_transition(BarState::Showing);
+    }
+    else if (!want_visible && state == BarState::Shown) {
+        begin_transition(BarState::Hiding);
+    }
+}
+
+void WaybarInstance::begin_transition(BarState next)
+{
+    if (!send_toggle()) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    HOTSPOTS_PROBE(bar_transition, process_name.c_str(), static_cast<int>(state), static_cast<int>(next));
+    global_plugin_state->state_snapshot.request();
+    state = next;
+    transition_started = now;
+    transition_deadline = now + std::chrono::milliseconds(global_plugin_state->transition_timeout_ms);
+    debug_log("%s: %s\n", process_name.c_str(), bar_state_name(state));
+    trace_instant(next == BarState::Showing ? "show requested" : "hide requested", process_name);
+    global_plugin_state->arm_transition_timer();
+}
+
+void WaybarInstance::announce(BarState from, BarState to) const
+{
+    bool was_visible = from == BarState::Shown || from == BarState::Hiding;
+    bool is_visible = to == BarState::Shown;
+    if (was_visible != is_visible) {
+        auto monitor = g_pCompositor->getMonitorFromID(monitor_id);
+        global_plugin_state->event_stream.emit(is_visible ? HotspotEventKind::Show : HotspotEventKind::Hide, process_name, monitor ? monitor->m_name : std::string{});
+    }
+}
+
+void WaybarInstance::set_state(BarState next)
+{
+    announce(state, next);
+    HOTSPOTS_PROBE(bar_transition, process_name.c_str(), static_cast<int>(state), static_cast<int>(next));
+    global_plugin_state->state_snapshot.request();
+    state = next;
+}
+
+void WaybarInstance::complete_transition(BarState final_state)
+{
+    // Every map/unmap answers one toggle we sent, unless none is outstanding
+    bool ours = pending_toggles > 0;
+    pending_toggles = std::max(pending_toggles - 1, 0);
+
+    bool confirmed = (state == BarState::Showing && final_state == BarState::Shown)
+        || (state == BarState::Hiding && final_state == BarState::Hidden);
+
+    if (confirmed) {
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - transition_started);
+        confirm_latency.record(elapsed.count());
+        trace_span(final_state == BarState::Shown ? "show" : "hide", transition_started, process_name, attempts);
+        debug_log("%s: %s confirmed after %.1f ms (%d retries)\n", process_name.c_str(), bar_state_name(final_state), elapsed.count(), attempts);
+    }
+    else if (state != final_state && !ours) {
+        // Someone else toggled the bar - follow the compositor rather than
+        // toggling it straight back
+        debug_log("%s: external change %s -> %s\n", process_name.c_str(), bar_state_name(state), bar_state_name(final_state));
+        want_visible = final_state == BarState::Shown;
+    }
+    else if (state != final_state) {
+        // A retry landing after the first toggle already did; put it right once
+        // nothing else is on its way
+        debug_log("%s: late toggle %s -> %s, %d still pending\n", process_name.c_str(), bar_state_name(state), bar_state_name(final_state), pending_toggles);
+    }
+
+    set_state(final_state);
+    attempts = 0;
+    drive();
+}
+
+void WaybarInstance::on_surface_mapped(const PHLLS& layer)
+{
+    remember_owner(layer);
+    complete_transition(BarState::Shown);
+}
+
+void WaybarInstance::on_surface_unmapped()
+{
+    complete_transition(BarState::Hidden);
+}
+
+void WaybarInstance::on_deadline()
+{
+    bool visible = is_actually_visible();
+
+    if (!in_flight()) {
+        // A retry's map/unmap never showed up; whatever it did has happened by now
+        debug_log("%s: %d toggles unaccounted for, resyncing\n", process_name.c_str(), pending_toggles);
+        pending_toggles = 0;
+        attempts = 0;
+        set_state(visible ? BarState::Shown : BarState::Hidden);
+        drive();
+        return;
+    }
+
+    bool reached = state == BarState::Showing ? visible : !visible;
+
+    if (reached) {
+        // The map/unmap happened but its event was not seen
+        complete_transition(visible ? BarState::Shown : BarState::Hidden);
+        return;
+    }
+
+    ++timeouts;
+
+    if (attempts < global_plugin_state->transition_retries && send_toggle()) {
+        ++attempts;
+        ++retries;
+        transition_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(global_plugin_state->transition_timeout_ms);
+        debug_log("%s: %s timed out, retry %d\n", process_name.c_str(), bar_state_name(state), attempts);
+        return;
+    }
+
+    // Give up and trust the compositor; the next hover starts over
+    debug_log("%s: %s timed out, giving up\n", process_name.c_str(), bar_state_name(state));
+    set_state(visible ? BarState::Shown : BarState::Hidden);
+    want_visible = visible;
+    attempts = 0;
+    pending_toggles = 0;
+}
+
+// Accepts "KEY" or "MODS, KEY" with Hyprland's modifier names
+auto parse_keybind(const std::string& spec) -> std::optional<KeyBind>
+{
+    auto vars = CVarList{ spec };
+    if (spec.empty() || vars.size() > 2) {
+        return std::nullopt;
+    }
+
+    auto key_name = vars[vars.size() - 1];
+    auto bind = KeyBind{};
+    bind.keysym = xkb_keysym_from_name(key_name.c_str(), XKB_KEYSYM_CASE_INSENSITIVE);
+
+    if (bind.keysym == XKB_KEY_NoSymbol) {
+        return std::nullopt;
+    }
+
+    if (vars.size() == 2) {
+        bind.modmask = g_pKeybindManager->stringToModMask(vars[0]);
+    }
+    return bind;
+}
+
+// Active layout first so its symbols win, then fill in from the other layouts
+void KeymapTable::rebuild()
+{
+    keycodes.clear();
+
+    if (!g_pSeatManager || !g_pSeatManager->m_keyboard || !g_pSeatManager->m_keyboard->m_xkbKeymap) {
+        return;
+    }
+
+    auto* keymap = g_pSeatManager->m_keyboard->m_xkbKeymap;
+    auto* xkb_state = g_pSeatManager->m_keyboard->m_xkbState;
+    auto keycode_min = xkb_keymap_min_keycode(keymap);
+    auto keycode_max = xkb_keymap_max_keycode(keymap);
+    auto active_layout = xkb_state ? xkb_state_serialize_layout(xkb_state, XKB_STATE_LAYOUT_EFFECTIVE) : 0;
+
+    auto add_layout = [&](xkb_layout_index_t layout) {
+        for (auto kc = keycode_min; kc <= keycode_max; ++kc) {
+            if (layout >= xkb_keymap_num_layouts_for_key(keymap, kc)) {
+                continue;
+            }
+            auto levels = xkb_keymap_num_levels_for_key(keymap, kc, layout);
+            for (xkb_level_index_t level = 0; level < levels; ++level) {
+                const xkb_keysym_t* syms = nullptr;
+                auto count = xkb_keymap_key_get_syms_by_level(keymap, kc, layout, level, &syms);
+                for (int i = 0; i < count; ++i) {
+                    keycodes.try_emplace(syms[i], kc - 8);
+                }
+            }
+        }
+    };
+
+    add_layout(active_layout);
+    for (xkb_layout_index_t layout = 0; layout < xkb_keymap_num_layouts(keymap); ++layout) {
+        if (layout != active_layout) {
+            add_layout(layout);
+        }
+    }
+
+    debug_log("Rebuilt keymap table: %zu keysyms (layout %u)\n", keycodes.size(), active_layout);
+}
+
+void KeymapTable::resolve(KeyBind& bind)
+{
+    auto it = keycodes.find(bind.keysym);
+    auto keycode = it != keycodes.end() ? it->second : 0;
+    // A key held down across a re-resolve still has its release coming
+    if (keycode != bind.keycode) {
+        bind.held = false;
+    }
+    bind.keycode = keycode;
+
+    if (bind.keycode != 0 && bind.keycode < max_keycode) {
+        bound.set(bind.keycode);
+    }
+}
+
+APICALL EXPORT std::string PLUGIN_API_VERSION()
+{
+    return HYPRLAND_API_VERSION;
+}
+
+std::string monitor_name_from_id(MONITORID monitor_id)
+{
+    auto monitor = g_pCompositor->getMonitorFromID(monitor_id);
+    return monitor ? monitor->m_name : std::to_string(monitor_id);
+}
+
+// The cursor moved to another monitor: settle the one it left as if the
+// cursor had moved off every region there
+void leave_monitor(MONITORID monitor_id)
+{
+    if (monitor_id < 0 || static_cast<size_t>(monitor_id) >= global_plugin_state->monitor_hover.size()) {
+        return;
+    }
+
+    auto& hover = global_plugin_state->monitor_hover[monitor_id];
+    auto& events = global_plugin_state->event_stream;
+    auto monitor_name = hover.hovered.empty() ? std::string{} : monitor_name_from_id(monitor_id);
+    if (!hover.hovered.empty() || hover.was_in_leave_area) {
+        global_plugin_state->state_snapshot.request();
+    }
+    for (auto& entry : hover.hovered) {
+        if (entry.entered) {
+            debug_log("Left monitor %ld from region %s - running leave actions\n", (long)monitor_id, entry.region->name.c_str());
+            entry.region->execute_leave_actions();
+        }
+        HOTSPOTS_PROBE(region_leave, entry.region->name.c_str(), static_cast<int64_t>(monitor_id));
+        events.emit(HotspotEventKind::Leave, entry.region->name, monitor_name);
+    }
+    if (hover.was_in_leave_area) {
+        global_plugin_state->start_hide_timer(monitor_id);
+    }
+
+    hover.hovered.clear();
+    hover.was_in_leave_area = false;
+    hover.was_in_enter_area = false;
+}
+
+// Number of region bounds a full hit-test on the monitor checks
+size_t hit_test_cost(MONITORID monitor_id)
+{
+    auto& regions = global_plugin_state->regions;
+    return static_cast<size_t>(monitor_id) < regions.hover.size() ? regions.hover[monitor_id].size() : 0;
+}
+
+// After a miss at (px, py), cache the largest rectangle the regions allow around it
+void remember_empty_rect(MONITORID monitor_id, int32_t px, int32_t py)
+{
+    auto& regions = global_plugin_state->regions;
+    auto& rect = global_plugin_state->empty_rect;
+    rect.monitor_id = monitor_id;
+    rect.generation = regions.generation;
+    rect.left = std::numeric_limits<int32_t>::min();
+    rect.top = std::numeric_limits<int32_t>::min();
+    rect.right = std::numeric_limits<int32_t>::max();
+    rect.bottom = std::numeric_limits<int32_t>::max();
+
+    if (static_cast<size_t>(monitor_id) >= regions.hover.size()) {
+        return;
+    }
+    for (auto& region : regions.hover[monitor_id]) {
+        if (regions.active[region.slot]) {
+            // The leave area normally contains the enter area; take both in case an expansion is negative
+            rect.exclude(px, py,
+                std::min(region.x, region.x - region.leave_expand_left),
+                std::min(region.y, region.y - region.leave_expand_up),
+                region.x + region.width + std::max(0, region.leave_expand_right),
+                region.y + region.height + std::max(0, region.leave_expand_down));
+        }
+    }
+}
+
+void update_mouse(int32_t mx, int32_t my)
+{
+    auto active_monitor = g_pCompositor->getMonitorFromCursor();
+    if (!active_monitor) {
+        return;
+    }
+
+    if (active_monitor->m_id != global_plugin_state->cursor_monitor) {
+        leave_monitor(global_plugin_state->cursor_monitor);
+        global_plugin_state->cursor_monitor = active_monitor->m_id;
+        global_plugin_state->state_snapshot.request();
+    }
+
+    if (static_cast<size_t>(active_monitor->m_id) >= global_plugin_state->regions.hover.size()) {
+        // Debug: Log monitor region issue
+        static bool logged_monitor_issue = false;
+        if (!logged_monitor_issue) {
+            debug_log("Monitor ID %ld exceeds regions size %zu\n", (long)active_monitor->m_id, global_plugin_state->regions.hover.size());
+            logged_monitor_issue = true;
+        }
+        return;
+    }
+
+    auto& hover = global_plugin_state->hover_state(active_monitor->m_id);
+    auto monitor_bounds = active_monitor->logicalBox();
+    auto monitor_local_x = mx - static_cast<int32_t>(monitor_bounds.pos().x);
+    auto monitor_local_y = my - static_cast<int32_t>(monitor_bounds.pos().y);
+
+    // Still inside the area the last miss proved empty, with nothing hovered
+    // that could be left: nothing to enter or leave
+    ++global_plugin_state->hit_tests;
+    if (hover.hovered.empty() && !hover.was_in_leave_area
+        && global_plugin_state->empty_rect.contains(active_monitor->m_id, global_plugin_state->regions.generation, monitor_local_x, monitor_local_y)) {
+        ++global_plugin_state->empty_rect_hits;
+        HOTSPOTS_PROBE(hit_test, static_cast<int64_t>(active_monitor->m_id), 0, 1);
+        global_plugin_state->region_checks_saved += hit_test_cost(active_monitor->m_id);
+        return;
+    }
+
+    auto& regions = global_plugin_state->regions.hover[active_monitor->m_id];
+    auto& order = global_plugin_state->regions.hover_order[active_monitor->m_id];
+    if (regions.empty()) {
+        // Debug: Log empty regions
+        static bool logged_empty_regions = false;
+        if (!logged_empty_regions) {
+            debug_log("No regions configured for monitor %ld\n", (long)active_monitor->m_id);
+            logged_empty_regions = true;
+        }
+        remember_empty_rect(active_monitor->m_id, monitor_local_x, monitor_local_y);
+        return;
+    }
+
+    // One pass in priority order. Each region under the cursor either stops the
+    // pass (exclusive, hold) or lets the regions below it be tested (through).
+    auto& next = global_plugin_state->next_hovered;
+    next.clear();
+    HoverRegion* holding = nullptr;
+    {
+        TraceScope trace("hit-test", "regions");
+        // Regions switched off by their rules (workspace, class, fullscreen) are skipped
+        auto& active = global_plugin_state->regions.active;
+        for (auto index : order) {
+            auto& region = regions[index];
+            if (!active[region.slot] || !region.is_in_leave_area(monitor_local_x, monitor_local_y)) {
+                continue;
+            }
+
+            auto previous = std::find_if(hover.hovered.begin(), hover.hovered.end(), [&](const HoveredRegion& entry) { return entry.region == &region; });
+            auto& entry = next.emplace_back(previous != hover.hovered.end() ? *previous : HoveredRegion{ &region });
+            entry.in_enter_area = region.is_in_enter_area(monitor_local_x, monitor_local_y);
+
+            if (region.overlap == OverlapPolicy::Hold) {
+                holding = &region;
+            }
+            if (region.overlap != OverlapPolicy::Through) {
+                break;
+            }
+        }
+        trace.arg = static_cast<int64_t>(next.size());
+    }
+
+    // A holding region leaves whatever was hovered below it as it was
+    if (holding) {
+        for (auto& entry : hover.hovered) {
+            if (RegionSet::ranks_below(*entry.region, *holding)) {
+                next.push_back(entry);
+            }
+        }
+    }
+    HOTSPOTS_PROBE(hit_test, static_cast<int64_t>(active_monitor->m_id), static_cast<int64_t>(next.size()), 0);
+
+    // Leaves first, then enters, like moving from one region into the next
+    for (auto& entry : hover.hovered) {
+        bool still_hovered = std::any_of(next.begin(), next.end(), [&](const HoveredRegion& other) { return other.region == entry.region; });
+        if (still_hovered) {
+            continue;
+        }
+        if (entry.entered) {
+            debug_log("Left region %s - running leave actions\n", entry.region->name.c_str());
+            entry.region->execute_leave_actions();
+        }
+        HOTSPOTS_PROBE(region_leave, entry.region->name.c_str(), static_cast<int64_t>(active_monitor->m_id));
+        global_plugin_state->event_stream.emit(HotspotEventKind::Leave, entry.region->name, active_monitor->m_name);
+    }
+
+    bool is_in_leave_area = false;
+    bool is_in_enter_area = false;
+    for (auto& entry : next) {
+        bool was_hovered = std::any_of(hover.hovered.begin(), hover.hovered.end(), [&](const HoveredRegion& other) { return other.region == entry.region; });
+        if (!was_hovered) {
+            HOTSPOTS_PROBE(region_enter, entry.region->name.c_str(), static_cast<int64_t>(active_monitor->m_id));
+            global_plugin_state->event_stream.emit(HotspotEventKind::Enter, entry.region->name, active_monitor->m_name);
+        }
+        // Like the bar, the other actions start from the enter area
+        if (entry.in_enter_area && !entry.entered) {
+            entry.entered = true;
+            if (entry.region->has_enter_actions()) {
+                debug_log("Entered region %s - running enter actions\n", entry.region->name.c_str());
+                entry.region->execute_enter_actions();
+            }
+        }
+        if (entry.region->has_bar()) {
+            is_in_leave_area = true;
+            is_in_enter_area |= entry.in_enter_area;
+        }
+    }
+
+    bool was_in_leave_area = hover.was_in_leave_area;
+    bool was_in_enter_area = hover.was_in_enter_area;
+
+    // State transition logic
+    if (is_in_enter_area && !was_in_enter_area) {
+        // Entered enter area - show this monitor's bars
+        global_plugin_state->cancel_hide_timer_if_active(active_monitor->m_id);
+        for (auto& entry : next) {
+            if (entry.in_enter_area && entry.region->allows_show()) {
+                entry.region->show();
+            }
+        }
+    }
+    else if (!is_in_leave_area && was_in_leave_area) {
+        // Left leave area completely - start hide timer
+        global_plugin_state->start_hide_timer(active_monitor->m_id);
+    }
+    else if (is_in_leave_area) {
+        // In any part of leave area - cancel timer to prevent hiding
+        global_plugin_state->cancel_hide_timer_if_active(active_monitor->m_id);
+    }
+
+    bool changed = next.size() != hover.hovered.size() || is_in_leave_area != was_in_leave_area || is_in_enter_area != was_in_enter_area
+        || !std::equal(next.begin(), next.end(), hover.hovered.begin(), [](const HoveredRegion& a, const HoveredRegion& b) { return a.region == b.region; });
+    if (changed) {
+        global_plugin_state->state_snapshot.request();
+    }
+
+    hover.hovered.swap(next);
+    hover.was_in_leave_area = is_in_leave_area;
+    hover.was_in_enter_area = is_in_enter_area;
+
+    if (hover.hovered.empty()) {
+        remember_empty_rect(active_monitor->m_id, monitor_local_x, monitor_local_y);
+    }
+    else {
+        // Only a miss makes the rectangle valid; leaving a region needs a full scan
+        global_plugin_state->empty_rect.invalidate();
+    }
+}
+
+void on_config_pre_reload()
+{
+    std::lock_guard<std::mutex> lock(global_plugin_state->regions_mutex);
+    for (auto& hover : global_plugin_state->monitor_hover) {
+        hover.hovered.clear();
+    }
+    global_plugin_state->regions.clear();
+}
+
+void on_config_reloaded()
+{
+    // Don't call reset() here - it stops the timer thread
+    // Just reset the state variables we need
+    global_plugin_state->clear_hover_state();
+
+    std::string toggle_bind_str = static_cast<Hyprlang::STRING>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:toggle_bind")->getDataStaticPtr());
+    std::string_view toggle_mode_str = static_cast<Hyprlang::STRING>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:toggle_mode")->getDataStaticPtr());
+    int64_t hide_delay = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:hide_delay")->getDataStaticPtr());
+
+    std::string_view pointer_sampling_str = static_cast<Hyprlang::STRING>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:pointer_sampling")->getDataStaticPtr());
+    int64_t pointer_interval = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:pointer_interval")->getDataStaticPtr());
+    int64_t action_window = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:action_window")->getDataStaticPtr());
+    int64_t action_max_inflight = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:action_max_inflight")->getDataStaticPtr());
+    int64_t show_on_workspace_change = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:show_on_workspace_change")->getDataStaticPtr());
+    int64_t workspace_debounce = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:workspace_debounce")->getDataStaticPtr());
+    int64_t event_socket = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:event_socket")->getDataStaticPtr());
+    int64_t state_snapshot = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:state_snapshot")->getDataStaticPtr());
+    int64_t trace = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:trace")->getDataStaticPtr());
+    int64_t trace_buffer_size = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:trace_buffer_size")->getDataStaticPtr());
+    int64_t transition_timeout = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:transition_timeout")->getDataStaticPtr());
+    int64_t transition_retries = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:transition_retries")->getDataStaticPtr());
+
+    auto toggle_bind = parse_keybind(toggle_bind_str);
+    global_plugin_state->toggle_bind = toggle_bind.value_or(KeyBind{});
+    global_plugin_state->hide_delay_ms = static_cast<int>(hide_delay);
+    global_plugin_state->show_on_workspace_change = show_on_workspace_change != 0;
+    global_plugin_state->workspace_debounce_ms = std::max<int>(static_cast<int>(workspace_debounce), 0);
+    global_plugin_state->transition_timeout_ms = std::max<int>(static_cast<int>(transition_timeout), 1);
+    global_plugin_state->transition_retries = std::max<int>(static_cast<int>(transition_retries), 0);
+    global_plugin_state->action_window_ms = std::max<int>(static_cast<int>(action_window), 0);
+    global_plugin_state->pointer_sampling = pointer_sampling_str == "interval" ? PointerSampling::Interval : PointerSampling::Frame;
+    global_plugin_state->pointer_interval_ms = std::max<int>(static_cast<int>(pointer_interval), 1);
+    global_plugin_state->action_max_inflight = std::max<int>(static_cast<int>(action_max_inflight), 1);
+
+    if (event_socket && !global_plugin_state->event_stream.is_open()) {
+        global_plugin_state->event_stream.open();
+    }
+    else if (!event_socket && global_plugin_state->event_stream.is_open()) {
+        global_plugin_state->event_stream.close();
+    }
+
+    if (state_snapshot) {
+        global_plugin_state->state_snapshot.open();
+    }
+    else {
+        global_plugin_state->state_snapshot.close();
+    }
+
+    tracer.capacity = static_cast<size_t>(std::max<int64_t>(trace_buffer_size, 16));
+    tracer.enabled = trace != 0;
+    if (!tracer.enabled) {
+        global_plugin_state->pending_bar_frames.clear();
+    }
+
+    // toggle_mode applies to toggle_bind and to region-specific binds alike
+    if (toggle_mode_str == "hold") {
+        global_plugin_state->toggle_mode = ToggleMode::Hold;
+    }
+    else if (toggle_mode_str == "press") {
+        global_plugin_state->toggle_mode = ToggleMode::Press;
+    }
+    else {
+        // add_notification("Invalid value for toggle_mode");
+    }
+
+    if (global_plugin_state->toggle_bind.valid()) {
+        global_plugin_state->allow_show_waybar = false;
+    }
+    else {
+        global_plugin_state->allow_show_waybar = true;
+        if (!toggle_bind_str.empty()) {
+            // add_notification("Invalid key name for toggle_bind");
+        }
+    }
+
+    // Update leave area cache for all existing regions
+    std::lock_guard<std::mutex> lock(global_plugin_state->regions_mutex);
+    for (auto& regions : global_plugin_state->regions.hover) {
+        for (auto& region : regions) {
+            if (region.has_bar()) {
+                region.update_leave_area_cache();
+            }
+        }
+    }
+
+    global_plugin_state->regions.recompute_active();
+
+    // The keymap may have changed along with the config
+    global_plugin_state->refresh_keybinds(true);
+    global_plugin_state->refresh_activity();
+}
+
+std::string trim_whitespace(const std::string& value)
+{
+    return std::regex_replace(value, std::regex("^\\s+|\\s+$"), "");
+}
+
+// Optional rules in a leading bracket, like Hyprland's exec rules:
+//   hypr-waybar-region = [name top-bar; workspace !name:gaming] DP-1, 0, 0, 1920, 30
+struct RegionRules
+{
+    std::string name;
+    std::string bind;
+    std::string axis;
+    ActivationRules activation;
+
+    // Hover regions only
+    std::optional<int> priority;
+    std::optional<OverlapPolicy> overlap;
+    std::string bar;
+    std::string on_enter;
+    std::string on_leave;
+    std::string dispatch;
+
+    bool has_hover_rules() const {
+        return priority || overlap || !bar.empty() || !on_enter.empty() || !on_leave.empty() || !dispatch.empty();
+    }
+};
+
+// Strips the rule block off the front of value. Returns an error message, empty on success.
+std::string parse_region_rules(std::string& value, RegionRules& rules)
+{
+    value = trim_whitespace(value);
+    if (value.empty() || value[0] != '[') {
+        return {};
+    }
+
+    auto close = value.find(']');
+    if (close == std::string::npos) {
+        return "Missing ']' after region rules.";
+    }
+
+    auto block = value.substr(1, close - 1);
+    value = trim_whitespace(value.substr(close + 1));
+
+    for (auto& entry : CVarList{ block, 0, ';', true }) {
+        auto rule = trim_whitespace(entry);
+        auto space = rule.find_first_of(" \t");
+        auto key = rule.substr(0, space);
+        auto arg = space == std::string::npos ? std::string{} : trim_whitespace(rule.substr(space + 1));
+
+        if (key == "name") {
+            if (arg.empty() || arg.find_first_of(" \t") != std::string::npos) {
+                return "Region names must be a single word.";
+            }
+            rules.name = arg;
+        }
+        else if (key == "bind") {
+            rules.bind = arg;
+        }
+        else if (key == "axis") {
+            if (arg != "vertical" && arg != "horizontal") {
+                return "The axis rule must be vertical or horizontal.";
+            }
+            rules.axis = arg;
+        }
+        else if (key == "workspace" || key == "class") {
+            bool negate = arg.starts_with("!");
+            if (negate) {
+                arg = trim_whitespace(arg.substr(1));
+            }
+            if (arg.empty()) {
+                return "The " + key + " rule needs a value.";
+            }
+
+            if (key == "workspace") {
+                rules.activation.workspaces.push_back({ arg, negate });
+                continue;
+            }
+            try {
+                rules.activation.classes.push_back({ std::regex(arg), negate });
+            }
+            catch (std::regex_error& ex) {
+                return "Invalid class regex `" + arg + "`.";
+            }
+        }
+        else if (key == "fullscreen") {
+            if (arg != "on" && arg != "off") {
+                return "The fullscreen rule must be on or off.";
+            }
+            rules.activation.over_fullscreen = arg == "on";
+        }
+        else if (key == "priority") {
+            try {
+                rules.priority = std::stoi(arg);
+            }
+            catch (std::exception& ex) {
+                return "The priority rule needs an integer.";
+            }
+        }
+        else if (key == "overlap") {
+            if (arg == "exclusive") {
+                rules.overlap = OverlapPolicy::Exclusive;
+            }
+            else if (arg == "through") {
+                rules.overlap = OverlapPolicy::Through;
+            }
+            else if (arg == "hold") {
+                rules.overlap = OverlapPolicy::Hold;
+            }
+            else {
+                return "The overlap rule must be exclusive, through or hold.";
+            }
+        }
+        else if (key == "bar" || key == "on_enter" || key == "on_leave" || key == "dispatch") {
+            if (arg.empty()) {
+                return "The " + key + " rule needs a value.";
+            }
+            auto& field = key == "bar" ? rules.bar : key == "on_enter" ? rules.on_enter : key == "on_leave" ? rules.on_leave : rules.dispatch;
+            field = arg;
+        }
+        else {
+            return "Unknown region rule `" + key + "`.";
+        }
+    }
+    return {};
+}
+
+// Applies the rules every hover region takes on top of what its keyword set.
+// Returns an error message, empty on success.
+std::string apply_hover_rules(RegionRules& rules, HoverRegion& region, PHLMONITOR monitor)
+{
+    if (!rules.axis.empty()) {
+        return "The axis rule is only supported on scroll regions.";
+    }
+
+    region.name = rules.name;
+    region.activation = std::move(rules.activation);
+    region.priority = rules.priority.value_or(region.priority);
+    region.overlap = rules.overlap.value_or(region.overlap);
+    region.dispatch = rules.dispatch;
+
+    for (auto [rule, field, key] : { std::tuple{ &rules.bar, &region.process_name, "bar" }, { &rules.on_enter, &region.enter_command, "on_enter" }, { &rules.on_leave, &region.leave_command, "on_leave" } }) {
+        if (rule->empty()) {
+            continue;
+        }
+        if (!field->empty()) {
+            return std::string("The ") + key + " rule repeats a value the region already has.";
+        }
+        *field = *rule;
+    }
+
+    if (!region.process_name.empty()) {
+        // Update the leave area cache for this region
+        region.update_leave_area_cache();
+        region.bar = global_plugin_state->waybar_instance(region.process_name, monitor);
+    }
+
+    if (!rules.bind.empty()) {
+        if (!region.has_bar()) {
+            return "The bind rule needs a region with a bar.";
+        }
+        region.bind = parse_keybind(rules.bind);
+        if (!region.bind) {
+            return "Invalid key in bind rule `" + rules.bind + "`.";
+        }
+    }
+
+    if (!region.has_bar() && !region.has_enter_actions()) {
+        return "The region has no action; give it a bar, on_enter, on_leave or dispatch rule.";
+    }
+    return {};
+}
+
+// MONITOR, X, Y, WIDTH, HEIGHT with the actions in the rules:
+//   hypr-region = [bar waybar; on_enter notify-send hi; priority 5] DP-1, 0, 0, 1920, 10
+std::string parse_hover_region(std::string value, HoverRegion& region, MONITORID& monitor_id)
+{
+    RegionRules rules;
+    if (auto error = parse_region_rules(value, rules); !error.empty()) {
+        return error;
+    }
+
+    auto vars = CVarList{ value };
+
+    if (vars.size() != 5) {
+        return "Invalid number of parameters passed to hypr-region";
+    }
+
+    auto monitor = g_pCompositor->getMonitorFromName(vars[0]);
+
+    if (!monitor) {
+        return "Failed to find monitor.";
+    }
+
+    try {
+        region.x = std::stoi(vars[1]);
+        region.y = std::stoi(vars[2]);
+        region.width = std::stoi(vars[3]);
+        region.height = std::stoi(vars[4]);
+    }
+    catch (std::exception& ex) {
+        return "Failed to parse `hypr-region` parameters as integers.";
+    }
+
+    if (auto error = apply_hover_rules(rules, region, monitor); !error.empty()) {
+        return error;
+    }
+
+    monitor_id = monitor->m_id;
+    return {};
+}
+
+std::string parse_waybar_region(std::string value, HoverRegion& region, MONITORID& monitor_id)
+{
+    RegionRules rules;
+    if (auto error = parse_region_rules(value, rules); !error.empty()) {
+        return error;
+    }
+
+    auto vars = CVarList{ value };
+
+    if (vars.size() < 5) {
+        return "Invalid number of parameters passed to hypr-waybar-region";
+    }
+
+    auto monitor = g_pCompositor->getMonitorFromName(vars[0]);
+
+    if (!monitor) {
+        return "Failed to find monitor.";
+    }
+
+    try {
+        region.x = std::stoi(vars[1]);
+        region.y = std::stoi(vars[2]);
+        region.width = std::stoi(vars[3]);
+        region.height = std::stoi(vars[4]);
+    }
+    catch (std::exception& ex) {
+        return "Failed to parse `hypr-waybar-region` parameters as integers.";
+    }
+
+    if (vars.size() == 6) {
+        region.process_name = vars[5];
+    }
+    else if (rules.bar.empty()) {
+        region.process_name = "waybar";
+    }
+
+    if (auto error = apply_hover_rules(rules, region, monitor); !error.empty()) {
+        return error;
+    }
+
+    monitor_id = monitor->m_id;
+    return {};
+}
+
+std::string parse_command_region(std::string value, HoverRegion& region, MONITORID& monitor_id)
+{
+    RegionRules rules;
+    if (auto error = parse_region_rules(value, rules); !error.empty()) {
+        return error;
+    }
+    
+    // Manual parsing to handle commands with spaces
+    auto comma_pos = std::vector<size_t>{};
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == ',') {
+            comma_pos.push_back(i);
+        }
+    }
+    
+    if (comma_pos.size() < 5) {
+        return "Invalid number of parameters passed to hypr-command-region. Expected at least 6.";
+    }
+    
+    // Extract parameters manually
+    auto monitor_name = value.substr(0, comma_pos[0]);
+    auto x_str = value.substr(comma_pos[0] + 1, comma_pos[1] - comma_pos[0] - 1);
+    auto y_str = value.substr(comma_pos[1] + 1, comma_pos[2] - comma_pos[1] - 1);
+    auto width_str = value.substr(comma_pos[2] + 1, comma_pos[3] - comma_pos[2] - 1);
+    auto height_str = value.substr(comma_pos[3] + 1, comma_pos[4] - comma_pos[3] - 1);
+    
+    std::string enter_command;
+    std::string leave_command;
+    
+    // Handle enter and leave commands
+    if (comma_pos.size() == 5) {
+        // Only enter command provided
+        enter_command = value.substr(comma_pos[4] + 1);
+    } else if (comma_pos.size() >= 6) {
+        // Both enter and leave commands provided
+        enter_command = value.substr(comma_pos[4] + 1, comma_pos[5] - comma_pos[4] - 1);
+        leave_command = value.substr(comma_pos[5] + 1);
+    }
+    
+    // Trim whitespace
+    monitor_name = trim_whitespace(monitor_name);
+    x_str = trim_whitespace(x_str);
+    y_str = trim_whitespace(y_str);
+    width_str = trim_whitespace(width_str);
+    height_str = trim_whitespace(height_str);
+    enter_command = trim_whitespace(enter_command);
+    leave_command = trim_whitespace(leave_command);
+
+    auto monitor = g_pCompositor->getMonitorFromName(monitor_name);
+    if (!monitor) {
+        return "Failed to find monitor for command region.";
+    }
+
+    try {
+        region.x = std::stoi(x_str);
+        region.y = std::stoi(y_str);
+        region.width = std::stoi(width_str);
+        region.height = std::stoi(height_str);
+    }
+    catch (std::exception& ex) {
+        return "Failed to parse `hypr-command-region` parameters as integers.";
+    }
+
+    // Command regions rank above bar regions and freeze them while hovered, as
+    // they always have unless the rules say otherwise
+    region.priority = 1;
+    region.overlap = OverlapPolicy::Hold;
+    region.enter_command = enter_command;
+    region.leave_command = leave_command;
+
+    if (auto error = apply_hover_rules(rules, region, monitor); !error.empty()) {
+        return error;
+    }
+
+    monitor_id = monitor->m_id;
+    return {};
+}
+
+auto parse_button(const std::string& name) -> std::optional<uint32_t>
+{
+    // Linux input event codes (BTN_LEFT and friends)
+    static const std::unordered_map<std::string, uint32_t> names = {
+        { "left", 0x110 }, { "right", 0x111 }, { "middle", 0x112 },
+        { "side", 0x113 }, { "extra", 0x114 }, { "forward", 0x115 }, { "back", 0x116 },
+    };
+
+    if (auto it = names.find(name); it != names.end()) {
+        return it->second;
+    }
+
+    try {
+        return static_cast<uint32_t>(std::stoul(name));
+    }
+    catch (std::exception& ex) {
+        return std::nullopt;
+    }
+}
+
+// Scroll:  MONITOR, X, Y, WIDTH, HEIGHT, COMMAND
+// Button:  MONITOR, X, Y, WIDTH, HEIGHT, BUTTON, COMMAND
+std::string parse_action_region(std::string value, ActionKind kind, ActionRegion& region, MONITORID& monitor_id)
+{
+    RegionRules rules;
+    if (auto error = parse_region_rules(value, rules); !error.empty()) {
+        return error;
+    }
+
+    const char* keyword = kind == ActionKind::Scroll ? "hypr-scroll-region" : "hypr-button-region";
+    size_t field_count = kind == ActionKind::Scroll ? 5 : 6;
+
+    // Everything after the fixed fields is the command, commas included
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (fields.size() < field_count) {
+        auto comma = value.find(',', start);
+        if (comma == std::string::npos) {
+            return std::string("Invalid number of parameters passed to ") + keyword;
+        }
+        fields.push_back(trim_whitespace(value.substr(start, comma - start)));
+        start = comma + 1;
+    }
+    auto command = trim_whitespace(value.substr(start));
+
+    if (command.empty()) {
+        return std::string("Missing command for ") + keyword;
+    }
+
+    auto monitor = g_pCompositor->getMonitorFromName(fields[0]);
+    if (!monitor) {
+        return "Failed to find monitor.";
+    }
+
+    try {
+        region.x = std::stoi(fields[1]);
+        region.y = std::stoi(fields[2]);
+        region.width = std::stoi(fields[3]);
+        region.height = std::stoi(fields[4]);
+    }
+    catch (std::exception& ex) {
+        return std::string("Failed to parse `") + keyword + "` parameters as integers.";
+    }
+
+    if (kind == ActionKind::Button) {
+        auto button = parse_button(fields[5]);
+        if (!button) {
+            return "Unknown mouse button `" + fields[5] + "`.";
+        }
+        region.button = *button;
+    }
+
+    if (!rules.bind.empty() || rules.has_hover_rules()) {
+        return "Scroll and button regions only take the name, workspace, class, fullscreen and axis rules.";
+    }
+
+    if (!rules.axis.empty() && kind != ActionKind::Scroll) {
+        return "The axis rule is only supported on scroll regions.";
+    }
+
+    region.name = rules.name;
+    region.activation = std::move(rules.activation);
+    region.kind = kind;
+    region.axis = rules.axis == "horizontal" ? WL_POINTER_AXIS_HORIZONTAL_SCROLL : WL_POINTER_AXIS_VERTICAL_SCROLL;
+    region.command = command;
+
+    monitor_id = monitor->m_id;
+    return {};
+}
+
+Hyprlang::CParseResult register_action_region(ActionKind kind, const char* v)
+{
+    auto result = Hyprlang::CParseResult{};
+    auto region = ActionRegion{};
+    MONITORID monitor_id = 0;
+
+    std::lock_guard<std::mutex> lock(global_plugin_state->regions_mutex);
+
+    auto error = parse_action_region(v, kind, region, monitor_id);
+    if (error.empty()) {
+        error = global_plugin_state->regions.add(std::move(region), monitor_id);
+    }
+
+    if (!error.empty()) {
+        add_notification(error);
+        result.setError(("[hypr-hotspots]: " + error).c_str());
+    }
+    return result;
+}
+
+Hyprlang::CParseResult register_scroll_region(const char* cmd, const char* v)
+{
+    return register_action_region(ActionKind::Scroll, v);
+}
+
+Hyprlang::CParseResult register_button_region(const char* cmd, const char* v)
+{
+    return register_action_region(ActionKind::Button, v);
+}
+
+using HoverRegionParser = std::string (*)(std::string, HoverRegion&, MONITORID&);
+
+Hyprlang::CParseResult register_hover_region(HoverRegionParser parse, const char* v)
+{
+    auto result = Hyprlang::CParseResult{};
+    auto region = HoverRegion{};
+    MONITORID monitor_id = 0;
+
+    std::lock_guard<std::mutex> lock(global_plugin_state->regions_mutex);
+
+    auto error = parse(v, region, monitor_id);
+    if (error.empty()) {
+        error = global_plugin_state->regions.add(std::move(region), monitor_id);
+    }
+
+    if (!error.empty()) {
+        add_notification(error);
+        result.setError(("[hypr-hotspots]: " + error).c_str());
+    }
+    return result;
+}
+
+Hyprlang::CParseResult register_region(const char* cmd, const char* v)
+{
+    return register_hover_region(parse_hover_region, v);
+}
+
+Hyprlang::CParseResult register_waybar_region(const char* cmd, const char* v)
+{
+    return register_hover_region(parse_waybar_region, v);
+}
+
+Hyprlang::CParseResult register_command_region(const char* cmd, const char* v)
+{
+    return register_hover_region(parse_command_region, v);
+}
+
+void try_update_hovered_region_state()
+{
+    if (!g_pCompositor || !global_plugin_state) {
+        return;
+    }
+
+    for (auto& hover : global_plugin_state->monitor_hover) {
+        for (auto& entry : hover.hovered) {
+            if (entry.region->has_bar() && global_plugin_state->regions.is_active(entry.region->slot) && entry.region->allows_show()) {
+                entry.region->show();
+            }
+        }
+    }
+}
+
+// Returns whether a scroll/button region took the input
+bool handle_action_input(ActionKind kind, wl_pointer_axis axis, uint32_t button, double value)
+{
+    auto pos = g_pInputManager->getMouseCoordsInternal();
+    auto monitor = g_pCompositor->getMonitorFromVector(pos);
+    auto& action_regions = global_plugin_state->regions.action;
+
+    if (!monitor || static_cast<size_t>(monitor->m_id) >= action_regions.size() || action_regions[monitor->m_id].empty()) {
+        return false;
+    }
+
+    auto monitor_bounds = monitor->logicalBox();
+    auto monitor_local_x = static_cast<int32_t>(pos.x - monitor_bounds.pos().x);
+    auto monitor_local_y = static_cast<int32_t>(pos.y - monitor_bounds.pos().y);
+
+    for (auto& region : action_regions[monitor->m_id]) {
+        bool matches = region.kind == kind && (kind == ActionKind::Scroll ? region.axis == axis : region.button == button);
+        if (matches && global_plugin_state->regions.is_active(region.slot) && region.is_in_area(monitor_local_x, monitor_local_y)) {
+            // Axis stop events are swallowed but add nothing
+            if (value != 0.0) {
+                global_plugin_state->queue_action(region, value);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// Hold: hotspots work while the key is down. Press: each press flips them on/off.
+bool apply_bind_key(KeyBind& bind, bool& allow, uint32_t keycode, bool pressed, uint32_t mods)
+{
+    if (bind.keycode != keycode) {
+        return false;
+    }
+
+    if (pressed) {
+        if ((mods & bind.modmask) != bind.modmask) {
+            return false;
+        }
+        bind.held = true;
+        if (global_plugin_state->toggle_mode == ToggleMode::Hold) {
+            allow = true;
+        }
+        return true;
+    }
+
+    // Releases only count for presses that matched, whatever modifiers are still down
+    if (!bind.held) {
+        return false;
+    }
+    bind.held = false;
+
+    switch (global_plugin_state->toggle_mode) {
+    case ToggleMode::Hold:
+        allow = false;
+        break;
+    case ToggleMode::Press:
+        allow = !allow;
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+void handle_bind_key(uint32_t keycode, bool pressed, uint32_t mods)
+{
+    bool matched = apply_bind_key(global_plugin_state->toggle_bind, global_plugin_state->allow_show_waybar, keycode, pressed, mods);
+
+    for (auto& regions : global_plugin_state->regions.hover) {
+        for (auto& region : regions) {
+            if (region.bind) {
+                matched |= apply_bind_key(*region.bind, region.allow_show, keycode, pressed, mods);
+            }
+        }
+    }
+
+    if (matched) {
+        global_plugin_state->state_snapshot.request();
+        try_update_hovered_region_state();
+        // Press mode may just have switched hotspots on or off
+        global_plugin_state->refresh_activity();
+    }
+}
+
+const char* pointer_sampling_name(PointerSampling sampling)
+{
+    return sampling == PointerSampling::Frame ? "frame" : "interval";
+}
+
+void append_latency_histogram(std::string& out, const LatencyStats& stats, bool json)
+{
+    auto& bounds = LatencyStats::bucket_bounds_ms;
+    if (json) {
+        append_format(out, "{\"count\":%lu,\"avg_ms\":%.3f,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f,\"buckets\":[",
+            stats.count, stats.average_ms(), stats.percentile_ms(50), stats.percentile_ms(99), stats.max_ms);
+        for (size_t bucket = 0; bucket < stats.buckets.size(); ++bucket) {
+            if (bucket < bounds.size()) {
+                append_format(out, "%s{\"le_ms\":%g,\"count\":%lu}", bucket ? "," : "", bounds[bucket], stats.buckets[bucket]);
+            }
+            else {
+                append_format(out, ",{\"le_ms\":null,\"count\":%lu}", stats.buckets[bucket]);
+            }
+        }
+        out += "]}";
+        return;
+    }
+
+    append_format(out, "%lu samples, avg %.2f ms, p50 <= %.2f ms, p99 <= %.2f ms, max %.2f ms\n    ",
+        stats.count, stats.average_ms(), stats.percentile_ms(50), stats.percentile_ms(99), stats.max_ms);
+    for (size_t bucket = 0; bucket < stats.buckets.size(); ++bucket) {
+        if (bucket < bounds.size()) {
+            append_format(out, "<=%gms: %lu  ", bounds[bucket], stats.buckets[bucket]);
+        }
+        else {
+            append_format(out, ">%gms: %lu\n", bounds.back(), stats.buckets[bucket]);
+        }
+    }
+}
+
+std::string hyprctl_stats(eHyprCtlOutputFormat format)
+{
+    std::string out;
+    auto& state = *global_plugin_state;
+    auto& workers = state.workers;
+    size_t queue_depth;
+    LatencyStats queue_wait;
+    {
+        std::lock_guard<std::mutex> lock(workers.mutex);
+        queue_depth = workers.jobs.size();
+        queue_wait = workers.queue_wait;
+    }
+    // Input events per action actually run
+    double coalescing_ratio = state.actions_run ? static_cast<double>(state.action_events) / state.actions_run : 0.0;
+    double empty_rect_hit_rate = state.hit_tests ? 100.0 * state.empty_rect_hits / state.hit_tests : 0.0;
+
+    if (format == eHyprCtlOutputFormat::FORMAT_JSON) {
+        out += "{\"bars\":[";
+        bool first = true;
+        for (auto& [name, bar] : global_plugin_state->waybar_instances) {
+            append_format(out, "%s{\"name\":\"%s\",\"pid\":%d,\"state\":\"%s\",\"confirmed\":%lu,\"last_ms\":%.2f,\"avg_ms\":%.2f,\"min_ms\":%.2f,\"max_ms\":%.2f,\"timeouts\":%lu,\"retries\":%lu}",
+                first ? "" : ",", escape_json(name).c_str(), bar.pid, bar_state_name(bar.state), bar.confirm_latency.count, bar.confirm_latency.last_ms,
+                bar.confirm_latency.average_ms(), bar.confirm_latency.min_ms, bar.confirm_latency.max_ms, bar.timeouts, bar.retries);
+            first = false;
+        }
+        out += "]";
+        append_format(out, ",\"actions\":{\"events\":%lu,\"run\":%lu,\"coalescing_ratio\":%.2f,\"deferred\":%lu,\"in_flight\":%d}",
+            state.action_events, state.actions_run, coalescing_ratio, state.actions_deferred, state.actions_in_flight->load());
+        append_format(out, ",\"pointer\":{\"sampling\":\"%s\",\"events\":%lu,\"updates\":%lu",
+            pointer_sampling_name(state.pointer_sampling), state.pointer_events, state.pointer_updates);
+        for (auto sampling : { PointerSampling::Frame, PointerSampling::Interval }) {
+            append_format(out, ",\"%s\":", pointer_sampling_name(sampling));
+            append_latency_histogram(out, state.pointer_latency[static_cast<size_t>(sampling)], true);
+        }
+        out += "}";
+        append_format(out, ",\"hit_tests\":{\"total\":%lu,\"empty_rect_hits\":%lu,\"hit_rate\":%.1f,\"region_checks_saved\":%lu}",
+            state.hit_tests, state.empty_rect_hits, empty_rect_hit_rate, state.region_checks_saved);
+        append_format(out, ",\"workspace_reveals\":{\"revealed\":%lu,\"suppressed\":%lu}", state.reveals, state.reveals_suppressed);
+        append_format(out, ",\"hooks\":{\"idle\":%s,\"idle_transitions\":%lu,\"active_transitions\":%lu,\"mouse_move\":%s,\"mouse_axis\":%s,\"mouse_button\":%s,\"key_press\":%s}",
+            state.idle ? "true" : "false", state.idle_transitions, state.wake_transitions, state.mouse_move_hook ? "true" : "false",
+            state.mouse_axis_hook ? "true" : "false", state.mouse_button_hook ? "true" : "false", state.key_press_hook ? "true" : "false");
+        auto& events = state.event_stream;
+        append_format(out, ",\"event_stream\":{\"open\":%s,\"clients\":%zu,\"emitted\":%lu,\"sent\":%lu,\"coalesced\":%lu,\"dropped_clients\":%lu}",
+            events.is_open() ? "true" : "false", events.clients.size(), events.events_emitted, events.events_sent, events.events_coalesced, events.clients_dropped);
+        auto& snapshot = state.state_snapshot;
+        append_format(out, ",\"state_snapshot\":{\"open\":%s,\"name\":\"%s\",\"requests\":%lu,\"updates\":%lu}",
+            snapshot.is_open() ? "true" : "false", escape_json(snapshot.name).c_str(), snapshot.requests, snapshot.updates);
+        append_format(out, ",\"workers\":{\"threads\":%zu,\"queue_depth\":%zu,\"max_queue_depth\":%zu,\"jobs_run\":%lu,\"queue_wait\":",
+            workers.threads.size(), queue_depth, workers.max_queue_depth, workers.jobs_run);
+        append_latency_histogram(out, queue_wait, true);
+        out += ",\"main_blocked\":";
+        append_latency_histogram(out, workers.main_blocked, true);
+        append_format(out, ",\"main_blocked_total_ms\":%.3f}", workers.main_blocked.total_ms);
+        out += "}";
+        return out;
+    }
+
+    append_format(out, "actions: %lu events -> %lu run (coalescing ratio %.2f), %lu deferred at the in-flight cap, %d in flight\n",
+        state.action_events, state.actions_run, coalescing_ratio, state.actions_deferred, state.actions_in_flight->load());
+
+    append_format(out, "pointer (sampling on %s): %lu events -> %lu updates\n",
+        pointer_sampling_name(state.pointer_sampling), state.pointer_events, state.pointer_updates);
+    for (auto sampling : { PointerSampling::Frame, PointerSampling::Interval }) {
+        append_format(out, "  %s, event to action: ", pointer_sampling_name(sampling));
+        append_latency_histogram(out, state.pointer_latency[static_cast<size_t>(sampling)], false);
+    }
+
+    append_format(out, "hit-tests: %lu positions, %lu (%.1f%%) inside the cached empty rectangle, %lu region checks saved\n",
+        state.hit_tests, state.empty_rect_hits, empty_rect_hit_rate, state.region_checks_saved);
+    append_format(out, "workspace reveals: %lu, %lu suppressed during a burst\n", state.reveals, state.reveals_suppressed);
+    append_format(out, "input hooks: %s (%lu idle, %lu active transitions), registered:%s%s%s%s\n",
+        state.idle ? "idle" : "active", state.idle_transitions, state.wake_transitions,
+        state.mouse_move_hook ? " mouseMove" : "", state.mouse_axis_hook ? " mouseAxis" : "",
+        state.mouse_button_hook ? " mouseButton" : "", state.key_press_hook ? " keyPress" : "");
+
+    auto& events = state.event_stream;
+    if (events.is_open()) {
+        append_format(out, "event stream (%s): %zu clients, %lu events -> %lu lines sent, %lu coalesced, %lu clients dropped\n",
+            events.path.c_str(), events.clients.size(), events.events_emitted, events.events_sent, events.events_coalesced, events.clients_dropped);
+    }
+    else {
+        out += "event stream: closed\n";
+    }
+
+    auto& snapshot = state.state_snapshot;
+    if (snapshot.is_open()) {
+        append_format(out, "state snapshot (/dev/shm%s): %lu change requests -> %lu updates\n", snapshot.name.c_str(), snapshot.requests, snapshot.updates);
+    }
+    else {
+        out += "state snapshot: closed\n";
+    }
+
+    append_format(out, "workers: %zu threads, queue depth %zu (max %zu), %lu jobs completed\n",
+        workers.threads.size(), queue_depth, workers.max_queue_depth, workers.jobs_run);
+    out += "  queue wait: ";
+    append_latency_histogram(out, queue_wait, false);
+    append_format(out, "  main thread blocked (%.1f ms total): ", workers.main_blocked.total_ms);
+    append_latency_histogram(out, workers.main_blocked, false);
+
+    out += "bars:\n";
+    for (auto& [name, bar] : global_plugin_state->waybar_instances) {
+        append_format(out, "  %s (pid %d): %s, confirmed %lu (last %.1f ms, avg %.1f ms, min %.1f ms, max %.1f ms), timeouts %lu, retries %lu\n",
+            name.c_str(), bar.pid, bar_state_name(bar.state), bar.confirm_latency.count, bar.confirm_latency.last_ms,
+            bar.confirm_latency.average_ms(), bar.confirm_latency.min_ms, bar.confirm_latency.max_ms, bar.timeouts, bar.retries);
+    }
+
+    out += "waybar regions:\n";
+    for (size_t monitor_id = 0; monitor_id < global_plugin_state->regions.hover.size(); ++monitor_id) {
+        for (auto& region : global_plugin_state->regions.hover[monitor_id]) {
+            if (!region.has_bar()) {
+                continue;
+            }
+            append_format(out, "  %s (monitor %zu): %d,%d %dx%d -> %s\n", region.name.c_str(), monitor_id, region.x, region.y, region.width, region.height, region.process_name.c_str());
+        }
+    }
+    return out;
+}
+
+const char* overlap_policy_name(OverlapPolicy policy)
+{
+    switch (policy) {
+    case OverlapPolicy::Through:
+        return "through";
+    case OverlapPolicy::Hold:
+        return "hold";
+    default:
+        return "exclusive";
+    }
+}
+
+std::string hyprctl_list(eHyprCtlOutputFormat format)
+{
+    std::string out;
+    auto& regions = global_plugin_state->regions;
+    bool json = format == eHyprCtlOutputFormat::FORMAT_JSON;
+    bool first = true;
+
+    if (json) {
+        out += "[";
+    }
+
+    for (size_t monitor_id = 0; monitor_id < regions.hover.size(); ++monitor_id) {
+        auto monitor_name = monitor_name_from_id(monitor_id);
+        // Walk order, which is also the order overlaps are settled in
+        for (auto index : regions.hover_order[monitor_id]) {
+            auto& region = regions.hover[monitor_id][index];
+            auto type = !region.has_bar() ? "command" : region.has_enter_actions() ? "region" : "waybar";
+            if (json) {
+                out += std::string(first ? "" : ",") + "{\"name\":\"" + escape_json(region.name) + "\",\"type\":\"" + type + "\",\"monitor\":\"" + escape_json(monitor_name) + "\"";
+                append_format(out, ",\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d,\"active\":%s,\"priority\":%d,\"overlap\":\"%s\"", region.x, region.y, region.width, region.height,
+                    regions.is_active(region.slot) ? "true" : "false", region.priority, overlap_policy_name(region.overlap));
+                if (region.has_bar()) {
+                    out += ",\"process\":\"" + escape_json(region.process_name) + "\"";
+                }
+                if (!region.enter_command.empty() || !region.leave_command.empty()) {
+                    out += ",\"enter\":\"" + escape_json(region.enter_command) + "\",\"leave\":\"" + escape_json(region.leave_command) + "\"";
+                }
+                if (!region.dispatch.empty()) {
+                    out += ",\"dispatch\":\"" + escape_json(region.dispatch) + "\"";
+                }
+                out += "}";
+            }
+            else {
+                append_format(out, "%s: %s on %s at %d,%d %dx%d, priority %d, %s%s%s%s\n", region.name.c_str(), type, monitor_name.c_str(), region.x, region.y, region.width, region.height,
+                    region.priority, overlap_policy_name(region.overlap), region.has_bar() ? " -> " : "", region.process_name.c_str(), regions.is_active(region.slot) ? "" : " (inactive)");
+                if (!region.enter_command.empty()) {
+                    out += "  enter: " + region.enter_command + "\n";
+                }
+                if (!region.leave_command.empty()) {
+                    out += "  leave: " + region.leave_command + "\n";
+                }
+                if (!region.dispatch.empty()) {
+                    out += "  dispatch: " + region.dispatch + "\n";
+                }
+            }
+            first = false;
+        }
+    }
+
+    for (size_t monitor_id = 0; monitor_id < regions.action.size(); ++monitor_id) {
+        auto monitor_name = monitor_name_from_id(monitor_id);
+        for (auto& region : regions.action[monitor_id]) {
+            auto type = region.kind == ActionKind::Scroll ? "scroll" : "button";
+            if (json) {
+                out += std::string(first ? "" : ",") + "{\"name\":\"" + escape_json(region.name) + "\",\"type\":\"" + type + "\",\"monitor\":\"" + escape_json(monitor_name) + "\"";
+                append_format(out, ",\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d,\"active\":%s", region.x, region.y, region.width, region.height, regions.is_active(region.slot) ? "true" : "false");
+                out += ",\"command\":\"" + escape_json(region.command) + "\"}";
+            }
+            else {
+                append_format(out, "%s: %s on %s at %d,%d %dx%d%s\n", region.name.c_str(), type, monitor_name.c_str(), region.x, region.y, region.width, region.height,
+                    regions.is_active(region.slot) ? "" : " (inactive)");
+                out += "  run: " + region.command + "\n";
+            }
+            first = false;
+        }
+    }
+
+    if (json) {
+        out += "]";
+    }
+    else if (first) {
+        out += "no regions\n";
+    }
+    return out;
+}
+
+// hotspots add <name> region|waybar|command|scroll|button <same value as the config keyword>
+std::string hyprctl_add(CVarList& args)
+{
+    if (args.size() < 5) {
+        return "usage: hyprctl hotspots add <name> region|waybar|command|scroll|button <monitor>, <x>, <y>, <width>, <height>, ...";
+    }
 
-    for (auto kc = keycode_min; kc <= keycode_max; ++kc) {
-        if (sym == xkb_state_key_get_one_sym(xkb_state, kc)) {
-            global_plugin_state->keycode_cache[name] = kc - 8;
-            return kc - 8;
+    auto name = args[2];
+    auto type = args[3];
+    auto definition = trim_whitespace(args.join(" ", 4));
+    // Fold the name into any rule block the definition already has
+    definition = definition.starts_with("[") ? "[name " + name + "; " + definition.substr(1) : "[name " + name + "] " + definition;
+    auto staged = global_plugin_state->regions;
+    MONITORID monitor_id = 0;
+    std::string error;
+
+    if (type == "region" || type == "waybar" || type == "command") {
+        auto region = HoverRegion{};
+        auto parse = type == "region" ? parse_hover_region : type == "waybar" ? parse_waybar_region : parse_command_region;
+        error = parse(definition, region, monitor_id);
+        if (error.empty()) {
+            error = staged.add(std::move(region), monitor_id);
+        }
+    }
+    else if (type == "scroll" || type == "button") {
+        auto region = ActionRegion{};
+        error = parse_action_region(definition, type == "scroll" ? ActionKind::Scroll : ActionKind::Button, region, monitor_id);
+        if (error.empty()) {
+            error = staged.add(std::move(region), monitor_id);
         }
     }
+    else {
+        error = "Unknown region type `" + type + "`, expected region, waybar, command, scroll or button.";
+    }
 
-    return std::nullopt;
-}
+    if (!error.empty()) {
+        return error;
+    }
 
-APICALL EXPORT std::string PLUGIN_API_VERSION()
-{
-    return HYPRLAND_API_VERSION;
+    global_plugin_state->replace_regions(std::move(staged));
+    return "ok";
 }
 
-void hide_all()
+// hotspots remove <name> [<name>...] - all or nothing
+std::string hyprctl_remove(CVarList& args)
 {
-    global_plugin_state->start_hide_timer();
+    if (args.size() < 3) {
+        return "usage: hyprctl hotspots remove <name> [<name>...]";
+    }
+
+    auto staged = global_plugin_state->regions;
+    for (size_t i = 2; i < args.size(); ++i) {
+        if (!args[i].empty() && !staged.remove(args[i])) {
+            return "No region named `" + args[i] + "`.";
+        }
+    }
+
+    global_plugin_state->replace_regions(std::move(staged));
+    return "ok";
 }
 
-void update_mouse(int32_t mx, int32_t my)
+// hotspots move <name> <x> <y> [<width> <height>]
+std::string hyprctl_move(CVarList& args)
 {
-    auto active_monitor = g_pCompositor->getMonitorFromCursor();
-    if (!active_monitor) {
-        return;
+    if (args.size() != 5 && args.size() != 7) {
+        return "usage: hyprctl hotspots move <name> <x> <y> [<width> <height>]";
     }
 
-    // Check if there's a fullscreen window on the active monitor
-    auto workspace = g_pCompositor->getWorkspaceByID(active_monitor->activeWorkspaceID());
-    if (workspace && workspace->m_hasFullscreenWindow) {
-        // Don't process hotspots when there's a fullscreen window
-        return;
+    int32_t x, y, width = -1, height = -1;
+    try {
+        x = std::stoi(args[3]);
+        y = std::stoi(args[4]);
+        if (args.size() == 7) {
+            width = std::stoi(args[5]);
+            height = std::stoi(args[6]);
+        }
+    }
+    catch (std::exception& ex) {
+        return "Failed to parse parameters as integers.";
     }
 
-    if (static_cast<size_t>(active_monitor->m_id) >= global_plugin_state->monitor_regions.size()) {
-        // Debug: Log monitor region issue
-        static bool logged_monitor_issue = false;
-        if (!logged_monitor_issue) {
-            debug_log("Monitor ID %ld exceeds regions size %zu\n", (long)active_monitor->m_id, global_plugin_state->monitor_regions.size());
-            logged_monitor_issue = true;
+    auto staged = global_plugin_state->regions;
+    auto apply = [&](auto* region) {
+        region->x = x;
+        region->y = y;
+        if (width >= 0) {
+            region->width = width;
+            region->height = height;
         }
-        return;
+    };
+
+    if (auto* region = staged.find_hover(args[2])) {
+        apply(region);
+    }
+    else if (auto* region = staged.find_action(args[2])) {
+        apply(region);
+    }
+    else {
+        return "No region named `" + args[2] + "`.";
     }
 
-    auto monitor_bounds = active_monitor->logicalBox();
-    auto monitor_local_x = mx - static_cast<int32_t>(monitor_bounds.pos().x);
-    auto monitor_local_y = my - static_cast<int32_t>(monitor_bounds.pos().y);
+    global_plugin_state->replace_regions(std::move(staged));
+    return "ok";
+}
 
-    // Check command regions first
-    CommandRegion* new_command_region = nullptr;
-    if (static_cast<size_t>(active_monitor->m_id) < global_plugin_state->monitor_command_regions.size()) {
-        auto& command_regions = global_plugin_state->monitor_command_regions[active_monitor->m_id];
-        for (auto& region : command_regions) {
-            if (region.is_in_area(monitor_local_x, monitor_local_y)) {
-                new_command_region = &region;
-                break;
-            }
-        }
-    }
+std::string hyprctl_trace(CVarList& args)
+{
+    auto action = args.size() > 2 ? args[2] : std::string{};
 
-    // Handle command region state changes
-    if (new_command_region != global_plugin_state->hovered_command_region) {
-        // Left previous command region
-        if (global_plugin_state->hovered_command_region) {
-            debug_log("Left command region - executing leave command\n");
-            global_plugin_state->hovered_command_region->execute_leave_command();
-        }
-        
-        // Entered new command region
-        if (new_command_region) {
-            debug_log("Entered command region - executing enter command\n");
-            new_command_region->execute_enter_command();
+    if (action == "on" || action == "off") {
+        tracer.enabled = action == "on";
+        if (!tracer.enabled) {
+            global_plugin_state->pending_bar_frames.clear();
         }
-        
-        global_plugin_state->hovered_command_region = new_command_region;
+        return std::string("tracing ") + action;
     }
 
-    // Continue with waybar region processing only if not in a command region
-    if (new_command_region) {
-        // If we're in a command region, don't process waybar regions
-        return;
+    if (action == "clear") {
+        tracer.clear();
+        return "ok";
     }
 
-    auto& regions = global_plugin_state->monitor_regions[active_monitor->m_id];
-    if (regions.empty()) {
-        // Debug: Log empty regions
-        static bool logged_empty_regions = false;
-        if (!logged_empty_regions) {
-            debug_log("No regions configured for monitor %ld\n", (long)active_monitor->m_id);
-            logged_empty_regions = true;
+    if (action == "dump" && args.size() > 3) {
+        std::string error;
+        auto path = args.join(" ", 3);
+        if (!tracer.dump(path, error)) {
+            return error;
         }
-        return;
+        return "wrote " + path;
     }
 
-    WaybarRegion* new_region = nullptr;
-    bool was_in_leave_area = global_plugin_state->was_in_leave_area_last_frame;
-    bool was_in_enter_area = global_plugin_state->was_in_enter_area_last_frame;
-    bool is_in_leave_area = false;
-    bool is_in_enter_area = false;
+    return "usage: hyprctl hotspots trace on|off|clear|dump <path>";
+}
 
-    // Find which region we're in (if any)
-    for (auto& region : regions) {
-        if (region.is_in_enter_area(monitor_local_x, monitor_local_y)) {
-            new_region = &region;
-            is_in_enter_area = true;
-            is_in_leave_area = true; // Enter area is also part of leave area
-            break;
-        }
-        else if (region.is_in_leave_area(monitor_local_x, monitor_local_y)) {
-            new_region = &region;
-            is_in_leave_area = true;
-            is_in_enter_area = false;
-            break;
-        }
+std::string hyprctl_hotspots(eHyprCtlOutputFormat format, std::string request)
+{
+    if (!global_plugin_state) {
+        return "hypr-hotspots not loaded";
     }
 
-    global_plugin_state->hovered_region = new_region;
+    auto args = CVarList{ request, 0, ' ' };
+    auto subcommand = args.size() > 1 ? args[1] : std::string{};
 
-    // State transition logic
-    if (is_in_enter_area && !was_in_enter_area) {
-        // Entered enter area - show waybar
-        global_plugin_state->cancel_hide_timer_if_active();
-        if (new_region) {
-            new_region->toggle();
-        }
+    if (subcommand == "stats") {
+        return hyprctl_stats(format);
     }
-    else if (!is_in_leave_area && was_in_leave_area) {
-        // Left leave area completely - start hide timer
-        hide_all();
+
+    if (subcommand == "trace") {
+        return hyprctl_trace(args);
     }
-    else if (is_in_leave_area) {
-        // In any part of leave area - cancel timer to prevent hiding
-        global_plugin_state->cancel_hide_timer_if_active();
+
+    if (subcommand == "list") {
+        return hyprctl_list(format);
     }
 
-    global_plugin_state->was_in_leave_area_last_frame = is_in_leave_area;
-    global_plugin_state->was_in_enter_area_last_frame = is_in_enter_area;
-}
+    if (subcommand == "add") {
+        return hyprctl_add(args);
+    }
 
-void on_config_pre_reload()
-{
-    std::lock_guard<std::mutex> lock(global_plugin_state->regions_mutex);
-    for (auto& regions : global_plugin_state->monitor_regions) {
-        regions.clear();
+    if (subcommand == "remove") {
+        return hyprctl_remove(args);
     }
-    for (auto& command_regions : global_plugin_state->monitor_command_regions) {
-        command_regions.clear();
+
+    if (subcommand == "move") {
+        return hyprctl_move(args);
     }
+
+    return "usage: hyprctl hotspots add|remove|move|list|stats|trace";
 }
 
-void on_config_reloaded()
+// Input hooks. PluginState::update_hooks() registers these only while something can fire.
+void on_mouse_move(void* handle, SCallbackInfo& callback_info, std::any value)
 {
-    // Don't call reset() here - it stops the timer thread
-    // Just reset the state variables we need
-    global_plugin_state->hovered_region = nullptr;
-    global_plugin_state->hovered_command_region = nullptr;
-    global_plugin_state->was_in_leave_area_last_frame = false;
-    global_plugin_state->was_in_enter_area_last_frame = false;
+    if (!global_plugin_state) return;
+    TraceScope trace("pointer event");
 
-    std::string toggle_bind_str = static_cast<Hyprlang::STRING>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:toggle_bind")->getDataStaticPtr());
-    std::string_view toggle_mode_str = static_cast<Hyprlang::STRING>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:toggle_mode")->getDataStaticPtr());
-    int64_t hide_delay = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:hide_delay")->getDataStaticPtr());
+    // Only remember where the cursor is; it is hit-tested once per frame (or interval)
+    global_plugin_state->on_pointer_moved(std::any_cast<const Vector2D>(value));
+}
 
-    global_plugin_state->toggle_bind_keycode = keycode_from_name(toggle_bind_str);
-    global_plugin_state->hide_delay_ms = static_cast<int>(hide_delay);
+void on_key_press(void* handle, SCallbackInfo& callback_info, std::any value)
+{
+    if (!global_plugin_state) return;
 
-    if (global_plugin_state->toggle_bind_keycode.has_value()) {
-        global_plugin_state->allow_show_waybar = false;
+    // Read the event in place - copying the map out of the any cost more than the rest of this hook
+    auto* storage = std::any_cast<std::unordered_map<std::string, std::any>>(&value);
+    if (!storage) return;
 
-        if (toggle_mode_str == "hold") {
-            global_plugin_state->toggle_mode = ToggleMode::Hold;
-        }
-        else if (toggle_mode_str == "press") {
-            global_plugin_state->toggle_mode = ToggleMode::Press;
-        }
-        else {
-            // add_notification("Invalid value for toggle_mode");
-        }
-    }
-    else {
-        global_plugin_state->allow_show_waybar = true;
-        global_plugin_state->toggle_mode = ToggleMode::Hover;
-        if (!toggle_bind_str.empty()) {
-            // add_notification("Invalid key name for toggle_bind");
-        }
+    auto event_it = storage->find("event");
+    auto* key_event = event_it != storage->end() ? std::any_cast<IKeyboard::SKeyEvent>(&event_it->second) : nullptr;
+    if (!key_event || !global_plugin_state->keymap_table.is_bound(key_event->keycode)) {
+        return;
     }
 
-    // Update leave area cache for all existing regions
-    std::lock_guard<std::mutex> lock(global_plugin_state->regions_mutex);
-    for (auto& regions : global_plugin_state->monitor_regions) {
-        for (auto& region : regions) {
-            region.update_leave_area_cache();
+    uint32_t mods = 0;
+    if (auto keyboard_it = storage->find("keyboard"); keyboard_it != storage->end()) {
+        auto* keyboard = std::any_cast<SP<IKeyboard>>(&keyboard_it->second);
+        if (keyboard && *keyboard) {
+            mods = (*keyboard)->getModifiers();
         }
     }
 
-    // Timer thread no longer needed - using simple detached threads
+    handle_bind_key(key_event->keycode, key_event->state == WL_KEYBOARD_KEY_STATE_PRESSED, mods);
 }
 
-Hyprlang::CParseResult register_waybar_region(const char* cmd, const char* v)
+void on_mouse_axis(void* handle, SCallbackInfo& callback_info, std::any value)
 {
-    auto result = Hyprlang::CParseResult{};
-    auto value = std::string{ v };
-    auto vars = CVarList{ value };
+    if (!global_plugin_state) return;
 
-    if (vars.size() < 5) {
-        add_notification("Invalid number of parameters passed to hypr-waybar-region");
-        result.setError("[hypr-hotspots]: Invalid number of parameters passed to hypr-waybar-region");
-        return result;
-    }
+    auto* storage = std::any_cast<std::unordered_map<std::string, std::any>>(&value);
+    if (!storage) return;
 
-    auto monitor = g_pCompositor->getMonitorFromName(vars[0]);
+    auto event_it = storage->find("event");
+    auto* axis_event = event_it != storage->end() ? std::any_cast<IPointer::SAxisEvent>(&event_it->second) : nullptr;
+    if (!axis_event) return;
 
-    if (!monitor) {
-        add_notification("Monitor not found");
-        result.setError("[hypr-hotspots]: Failed to find monitor.");
-        return result;
+    // Scrolling over a scroll region drives its action instead of the window below
+    if (handle_action_input(ActionKind::Scroll, axis_event->axis, 0, axis_event->delta)) {
+        callback_info.cancelled = true;
     }
+}
 
-    auto region = WaybarRegion{};
-
-    try {
-        region.x = std::stoi(vars[1]);
-        region.y = std::stoi(vars[2]);
-        region.width = std::stoi(vars[3]);
-        region.height = std::stoi(vars[4]);
-    }
-    catch (std::exception& ex) {
-        add_notification("Failed to parse `hypr-waybar-region` parameters as integers.");
-        result.setError("[hypr-hotspots]: Failed to parse parameters as integers.");
-        return result;
-    }
+void on_mouse_button(void* handle, SCallbackInfo& callback_info, std::any value)
+{
+    if (!global_plugin_state) return;
 
-    region.process_name = "waybar";
+    auto* button_event = std::any_cast<IPointer::SButtonEvent>(&value);
+    if (!button_event) return;
 
-    if (vars.size() == 6) {
-        region.process_name = vars[5];
+    // Presses over a button region are counted and kept from the window below,
+    // and so are their releases, wherever the cursor is by then. A release whose
+    // press reached the window goes to the window too.
+    auto& consumed = global_plugin_state->consumed_buttons;
+    if (button_event->state == WL_POINTER_BUTTON_STATE_PRESSED) {
+        if (handle_action_input(ActionKind::Button, WL_POINTER_AXIS_VERTICAL_SCROLL, button_event->button, 1.0)) {
+            consumed.insert(button_event->button);
+            callback_info.cancelled = true;
+        }
+        return;
     }
 
-    // Update the leave area cache for this region
-    region.update_leave_area_cache();
-
-    {
-        std::lock_guard<std::mutex> lock(global_plugin_state->regions_mutex);
-        global_plugin_state->monitor_regions[monitor->m_id].emplace_back(region);
+    if (consumed.erase(button_event->button) != 0) {
+        callback_info.cancelled = true;
+        // The pending release may be all that kept the button hook alive
+        if (!global_plugin_state->action_regions_live) {
+            global_plugin_state->update_hooks();
+        }
     }
-    return result;
 }
 
-Hyprlang::CParseResult register_command_region(const char* cmd, const char* v)
+void PluginState::refresh_activity()
 {
-    auto result = Hyprlang::CParseResult{};
-    auto value = std::string{ v };
-    
-    // Manual parsing to handle commands with spaces
-    auto comma_pos = std::vector<size_t>{};
-    for (size_t i = 0; i < value.size(); ++i) {
-        if (value[i] == ',') {
-            comma_pos.push_back(i);
+    pointer_regions_live = false;
+    action_regions_live = false;
+
+    // A held key must stay visible until it is released, or Hold mode never lets go
+    binds_live = toggle_bind.held;
+
+    for (auto& monitor_regions : regions.hover) {
+        for (auto& region : monitor_regions) {
+            binds_live |= region.bind && region.bind->held;
+            if (!regions.is_active(region.slot)) {
+                continue;
+            }
+            pointer_regions_live |= region.has_enter_actions();
+            if (region.has_bar()) {
+                pointer_regions_live |= region.allows_show();
+                binds_live |= region.bind ? true : toggle_bind.valid();
+            }
         }
     }
-    
-    if (comma_pos.size() < 5) {
-        add_notification("Invalid number of parameters passed to hypr-command-region. Expected at least 6.");
-        result.setError("[hypr-hotspots]: Invalid number of parameters passed to hypr-command-region");
-        return result;
-    }
-    
-    // Extract parameters manually
-    auto monitor_name = value.substr(0, comma_pos[0]);
-    auto x_str = value.substr(comma_pos[0] + 1, comma_pos[1] - comma_pos[0] - 1);
-    auto y_str = value.substr(comma_pos[1] + 1, comma_pos[2] - comma_pos[1] - 1);
-    auto width_str = value.substr(comma_pos[2] + 1, comma_pos[3] - comma_pos[2] - 1);
-    auto height_str = value.substr(comma_pos[3] + 1, comma_pos[4] - comma_pos[3] - 1);
-    
-    std::string enter_command;
-    std::string leave_command;
-    
-    // Handle enter and leave commands
-    if (comma_pos.size() == 5) {
-        // Only enter command provided
-        enter_command = value.substr(comma_pos[4] + 1);
-    } else if (comma_pos.size() >= 6) {
-        // Both enter and leave commands provided
-        enter_command = value.substr(comma_pos[4] + 1, comma_pos[5] - comma_pos[4] - 1);
-        leave_command = value.substr(comma_pos[5] + 1);
+    for (auto& monitor_regions : regions.action) {
+        for (auto& region : monitor_regions) {
+            action_regions_live |= regions.is_active(region.slot);
+        }
     }
-    
-    // Trim whitespace
-    monitor_name = std::regex_replace(monitor_name, std::regex("^\\s+|\\s+$"), "");
-    x_str = std::regex_replace(x_str, std::regex("^\\s+|\\s+$"), "");
-    y_str = std::regex_replace(y_str, std::regex("^\\s+|\\s+$"), "");
-    width_str = std::regex_replace(width_str, std::regex("^\\s+|\\s+$"), "");
-    height_str = std::regex_replace(height_str, std::regex("^\\s+|\\s+$"), "");
-    enter_command = std::regex_replace(enter_command, std::regex("^\\s+|\\s+$"), "");
-    leave_command = std::regex_replace(leave_command, std::regex("^\\s+|\\s+$"), "");
 
-    auto monitor = g_pCompositor->getMonitorFromName(monitor_name);
-    if (!monitor) {
-        add_notification("Monitor not found for command region");
-        result.setError("[hypr-hotspots]: Failed to find monitor.");
-        return result;
-    }
+    update_hooks();
+}
 
-    auto region = CommandRegion{};
+// Cheap enough to run after every pointer update: the region scan is cached by refresh_activity()
+void PluginState::update_hooks()
+{
+    // Something hovered still needs the pointer to see the cursor leave
+    bool hover_pending = std::any_of(monitor_hover.begin(), monitor_hover.end(), [](const MonitorHoverState& hover) {
+        return !hover.hovered.empty() || hover.was_in_leave_area;
+    });
 
-    try {
-        region.x = std::stoi(x_str);
-        region.y = std::stoi(y_str);
-        region.width = std::stoi(width_str);
-        region.height = std::stoi(height_str);
-    }
-    catch (std::exception& ex) {
-        add_notification("Failed to parse `hypr-command-region` parameters as integers.");
-        result.setError("[hypr-hotspots]: Failed to parse parameters as integers.");
-        return result;
-    }
+    auto set_hook = [this](SP<HOOK_CALLBACK_FN>& hook, bool wanted, const char* event, HOOK_CALLBACK_FN fn) {
+        if (wanted && !hook) {
+            hook = HyprlandAPI::registerCallbackDynamic(handle, event, std::move(fn));
+        }
+        else if (!wanted && hook) {
+            hook.reset();
+        }
+    };
 
-    region.enter_command = enter_command;
-    region.leave_command = leave_command;
+    bool had_mouse_move = mouse_move_hook != nullptr;
+    set_hook(mouse_move_hook, pointer_regions_live || hover_pending, "mouseMove", on_mouse_move);
+    set_hook(mouse_axis_hook, action_regions_live, "mouseAxis", on_mouse_axis);
+    set_hook(mouse_button_hook, action_regions_live || !consumed_buttons.empty(), "mouseButton", on_mouse_button);
+    set_hook(key_press_hook, binds_live, "keyPress", on_key_press);
 
-    {
-        std::lock_guard<std::mutex> lock(global_plugin_state->regions_mutex);
-        if (global_plugin_state->monitor_command_regions.size() <= static_cast<size_t>(monitor->m_id)) {
-            global_plugin_state->monitor_command_regions.resize(monitor->m_id + 1);
-        }
-        global_plugin_state->monitor_command_regions[monitor->m_id].emplace_back(region);
+    // The cursor may have moved onto a region while nobody was listening. The last
+    // sample may be stale at the same position, so hit-test it regardless.
+    if (mouse_move_hook && !had_mouse_move && g_pInputManager) {
+        schedule_pointer(g_pInputManager->getMouseCoordsInternal());
     }
-    return result;
-}
 
-void try_update_hovered_region_state()
-{
-    if (!g_pCompositor || !global_plugin_state || !global_plugin_state->hovered_region) {
-        return;
-    }
-    
-    if (global_plugin_state->toggle_in_progress) {
-        return;
-    }
-    
-    bool actually_visible = global_plugin_state->hovered_region->is_actually_visible();
-    
-    global_plugin_state->hovered_region->visible = actually_visible;
-    
-    if (global_plugin_state->allow_show_waybar && !actually_visible) {
-        global_plugin_state->hovered_region->toggle();
+    bool now_idle = !mouse_move_hook && !mouse_axis_hook && !mouse_button_hook;
+    if (now_idle != idle) {
+        idle = now_idle;
+        ++(idle ? idle_transitions : wake_transitions);
+        state_snapshot.request();
+        debug_log("Input hooks %s\n", idle ? "removed - idle" : "registered - active");
+        trace_instant(idle ? "idle" : "active");
     }
 }
 
@@ -794,13 +4188,10 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle)
         }
         
         // Manually initialize state variables
-        global_plugin_state->hovered_region = nullptr;
-        global_plugin_state->hovered_command_region = nullptr;
         global_plugin_state->allow_show_waybar = true;
         global_plugin_state->toggle_mode = ToggleMode::Hover;
-        global_plugin_state->toggle_bind_keycode = std::nullopt;
+        global_plugin_state->toggle_bind = KeyBind{};
         global_plugin_state->hide_delay_ms = 0;
-        global_plugin_state->was_in_leave_area_last_frame = false;
 
         // Check if compositor is available
         if (!g_pCompositor) {
@@ -816,8 +4207,8 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle)
 
         // Initialize monitor regions safely
         if (!g_pCompositor->m_monitors.empty()) {
-            global_plugin_state->monitor_regions.resize(g_pCompositor->m_monitors.size());
-            global_plugin_state->monitor_command_regions.resize(g_pCompositor->m_monitors.size());
+            global_plugin_state->regions.hover.resize(g_pCompositor->m_monitors.size());
+            global_plugin_state->regions.hover_order.resize(g_pCompositor->m_monitors.size());
         }
 
         debug_file = fopen("/tmp/hypr-hotspots.log", "a");
@@ -836,6 +4227,17 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle)
         HyprlandAPI::addConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:leave_expand_up", Hyprlang::INT{0});
         HyprlandAPI::addConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:leave_expand_down", Hyprlang::INT{0});
         HyprlandAPI::addConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:show_on_workspace_change", Hyprlang::INT{1});
+        HyprlandAPI::addConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:workspace_debounce", Hyprlang::INT{1000});
+        HyprlandAPI::addConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:pointer_sampling", Hyprlang::STRING{"frame"});
+        HyprlandAPI::addConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:pointer_interval", Hyprlang::INT{16});
+        HyprlandAPI::addConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:transition_timeout", Hyprlang::INT{300});
+        HyprlandAPI::addConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:transition_retries", Hyprlang::INT{2});
+        HyprlandAPI::addConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:action_window", Hyprlang::INT{50});
+        HyprlandAPI::addConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:action_max_inflight", Hyprlang::INT{2});
+        HyprlandAPI::addConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:event_socket", Hyprlang::INT{1});
+        HyprlandAPI::addConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:state_snapshot", Hyprlang::INT{1});
+        HyprlandAPI::addConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:trace", Hyprlang::INT{0});
+        HyprlandAPI::addConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:trace_buffer_size", Hyprlang::INT{4096});
         HyprlandAPI::addConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:debug", Hyprlang::INT{0});
 
         debug_file = fopen("/tmp/hypr-hotspots.log", "a");
@@ -846,8 +4248,11 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle)
         }
 
         // Register config keywords with the new nested structure:
+        HyprlandAPI::addConfigKeyword(global_plugin_state->handle, "hypr-region", register_region, Hyprlang::SHandlerOptions{});
         HyprlandAPI::addConfigKeyword(global_plugin_state->handle, "hypr-waybar-region", register_waybar_region, Hyprlang::SHandlerOptions{});
         HyprlandAPI::addConfigKeyword(global_plugin_state->handle, "hypr-command-region", register_command_region, Hyprlang::SHandlerOptions{});
+        HyprlandAPI::addConfigKeyword(global_plugin_state->handle, "hypr-scroll-region", register_scroll_region, Hyprlang::SHandlerOptions{});
+        HyprlandAPI::addConfigKeyword(global_plugin_state->handle, "hypr-button-region", register_button_region, Hyprlang::SHandlerOptions{});
 
         debug_file = fopen("/tmp/hypr-hotspots.log", "a");
         if (debug_file) {
@@ -856,28 +4261,6 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle)
             fclose(debug_file);
         }
 
-        // Register callbacks with throttling
-        static auto mouse_move = HyprlandAPI::registerCallbackDynamic(global_plugin_state->handle, "mouseMove", [](void* handle, SCallbackInfo& callback_info, std::any value) {
-            if (!global_plugin_state) return;
-            
-            // Throttle mouse updates to every 16ms (~60fps) to prevent system sluggishness
-            static auto last_update = std::chrono::steady_clock::now();
-            auto now = std::chrono::steady_clock::now();
-            if (std::chrono::duration_cast<std::chrono::milliseconds>(now - last_update).count() < 16) {
-                return; // Skip this update
-            }
-            last_update = now;
-            
-            auto pos = std::any_cast<const Vector2D>(value);
-            update_mouse(static_cast<int32_t>(pos.x), static_cast<int32_t>(pos.y));
-        });
-
-        debug_file = fopen("/tmp/hypr-hotspots.log", "a");
-        if (debug_file) {
-            fprintf(debug_file, "Registered mouse callback\n");
-            fflush(debug_file);
-            fclose(debug_file);
-        }
 
         static auto pre_config_reload = HyprlandAPI::registerCallbackDynamic(global_plugin_state->handle, "preConfigReload", [&](void* self, SCallbackInfo& info, std::any data) { 
             if (global_plugin_state) on_config_pre_reload(); 
@@ -889,87 +4272,112 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle)
 
         static auto workspace_changed = HyprlandAPI::registerCallbackDynamic(global_plugin_state->handle, "workspace", [](void* handle, SCallbackInfo& callback_info, std::any value) {
             if (!global_plugin_state) return;
-            
-            int64_t show_on_workspace_change = *static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:show_on_workspace_change")->getDataStaticPtr());
-            
-            if (show_on_workspace_change && !global_plugin_state->monitor_regions.empty()) {
-                if (global_plugin_state->hide_delay_ms > 0) {
-                    if (is_debug_enabled()) {
-                        FILE* debug_file = fopen("/tmp/hypr-hotspots.log", "a");
-                        if (debug_file) {
-                            fprintf(debug_file, "Workspace changed - canceling timers and showing waybar\n");
-                            fflush(debug_file);
-                            fclose(debug_file);
-                        }
-                    }
-                    
-                    // Cancel any existing timers to prevent hiding during workspace switching
-                    global_plugin_state->cancel_hide_timer_if_active();
-                    global_plugin_state->cancel_workspace_timer_if_active();
-                    
-                    // Show all waybar regions that aren't currently visible
-                    std::lock_guard<std::mutex> lock(global_plugin_state->regions_mutex);
-                    for (auto& regions : global_plugin_state->monitor_regions) {
-                        for (auto& region : regions) {
-                            if (!region.is_actually_visible()) {
-                                region.toggle();
-                            }
-                        }
-                    }
-                    
-                    // Only start workspace timer if mouse is NOT in a leave area
-                    if (!global_plugin_state->was_in_leave_area_last_frame) {
-                        // Start debounced workspace timer - only starts hide timer after 1 second of no workspace changes
-                        global_plugin_state->start_workspace_timer();
-                        
-                        if (is_debug_enabled()) {
-                            FILE* debug_file = fopen("/tmp/hypr-hotspots.log", "a");
-                            if (debug_file) {
-                                fprintf(debug_file, "Started workspace timer (mouse not in leave area)\n");
-                                fflush(debug_file);
-                                fclose(debug_file);
-                            }
-                        }
-                    } else {
-                        if (is_debug_enabled()) {
-                            FILE* debug_file = fopen("/tmp/hypr-hotspots.log", "a");
-                            if (debug_file) {
-                                fprintf(debug_file, "Mouse in leave area - not starting workspace timer\n");
-                                fflush(debug_file);
-                                fclose(debug_file);
-                            }
-                        }
-                    }
+
+            global_plugin_state->regions.recompute_active();
+            global_plugin_state->refresh_activity();
+
+            // Only the monitor whose workspace changed is revealed
+            auto* workspace = std::any_cast<PHLWORKSPACE>(&value);
+            auto monitor = workspace && *workspace ? (*workspace)->m_monitor.lock() : g_pCompositor->getMonitorFromCursor();
+            if (monitor) {
+                global_plugin_state->reveal_monitor(monitor->m_id);
+            }
+        });
+
+        // Region rules depend on focus and fullscreen too; these are the only other places they are evaluated.
+        // Leaving fullscreen is also what brings the input hooks back after a game or video.
+        static auto active_window = HyprlandAPI::registerCallbackDynamic(global_plugin_state->handle, "activeWindow", [](void* handle, SCallbackInfo& callback_info, std::any value) {
+            if (!global_plugin_state) return;
+            global_plugin_state->regions.recompute_active();
+            global_plugin_state->refresh_activity();
+        });
+
+        static auto fullscreen = HyprlandAPI::registerCallbackDynamic(global_plugin_state->handle, "fullscreen", [](void* handle, SCallbackInfo& callback_info, std::any value) {
+            if (!global_plugin_state) return;
+            global_plugin_state->regions.recompute_active();
+            global_plugin_state->refresh_activity();
+        });
+
+        // A region only applies while its monitor exists. Recomputing also moves the
+        // region generation on, so update_mouse() drops its cached empty rectangle.
+        static auto monitor_added = HyprlandAPI::registerCallbackDynamic(global_plugin_state->handle, "monitorAdded", [](void* handle, SCallbackInfo& callback_info, std::any value) {
+            if (!global_plugin_state) return;
+            global_plugin_state->regions.recompute_active();
+            global_plugin_state->refresh_activity();
+        });
+
+        static auto monitor_removed = HyprlandAPI::registerCallbackDynamic(global_plugin_state->handle, "monitorRemoved", [](void* handle, SCallbackInfo& callback_info, std::any value) {
+            if (!global_plugin_state) return;
+            global_plugin_state->regions.recompute_active();
+            global_plugin_state->refresh_activity();
+        });
+
+
+
+
+        // Layout switches and new keyboards change which keycode produces each keysym
+        static auto active_layout = HyprlandAPI::registerCallbackDynamic(global_plugin_state->handle, "activeLayout", [](void* handle, SCallbackInfo& callback_info, std::any value) {
+            if (global_plugin_state) global_plugin_state->refresh_keybinds(true);
+        });
+
+        // Waybar shows/hides by mapping/unmapping its layer surface; these close the loop on toggles
+        static auto open_layer = HyprlandAPI::registerCallbackDynamic(global_plugin_state->handle, "openLayer", [](void* handle, SCallbackInfo& callback_info, std::any value) {
+            if (!global_plugin_state) return;
+
+            auto layer = std::any_cast<PHLLS>(value);
+            if (auto* bar = global_plugin_state->find_waybar_instance(layer)) {
+                trace_instant("layer mapped", layer->m_namespace, bar->monitor_id);
+                if (trace_enabled()) {
+                    global_plugin_state->pending_bar_frames.push_back({ bar->monitor_id, std::chrono::steady_clock::now(), layer->m_namespace });
                 }
+
+                bar->on_surface_mapped(layer);
+                global_plugin_state->arm_transition_timer();
             }
         });
 
-        static auto key_press = HyprlandAPI::registerCallbackDynamic(global_plugin_state->handle, "keyPress", [](void* handle, SCallbackInfo& callback_info, std::any value) {
-            if (!global_plugin_state || !global_plugin_state->toggle_bind_keycode.has_value()) {
-                return;
+        static auto close_layer = HyprlandAPI::registerCallbackDynamic(global_plugin_state->handle, "closeLayer", [](void* handle, SCallbackInfo& callback_info, std::any value) {
+            if (!global_plugin_state) return;
+
+            auto layer = std::any_cast<PHLLS>(value);
+            if (auto* bar = global_plugin_state->find_waybar_instance(layer)) {
+                trace_instant("layer unmapped", layer->m_namespace, bar->monitor_id);
+
+                bar->on_surface_unmapped();
+                global_plugin_state->arm_transition_timer();
             }
-            
-            auto storage = std::any_cast<std::unordered_map<std::string, std::any>>(value);
-            auto key_event = std::any_cast<IKeyboard::SKeyEvent>(storage.at("event"));
-
-            if (key_event.keycode == global_plugin_state->toggle_bind_keycode) {
-                switch (global_plugin_state->toggle_mode) {
-                case ToggleMode::Hold:
-                    global_plugin_state->allow_show_waybar = key_event.state == WL_KEYBOARD_KEY_STATE_PRESSED;
-                    break;
-                case ToggleMode::Press:
-                    if (key_event.state == WL_KEYBOARD_KEY_STATE_RELEASED) {
-                        global_plugin_state->allow_show_waybar = !global_plugin_state->allow_show_waybar;
-                    }
-                    break;
-                default:
-                    break;
-                }
+        });
+
+        // Runs buffered cursor motion on the monitor's frame and sends the events it
+        // produced. While tracing, also ends the map span at the end of the first
+        // frame rendered on the bar's monitor.
+        static auto pre_render = HyprlandAPI::registerCallbackDynamic(global_plugin_state->handle, "preRender", [](void* handle, SCallbackInfo& callback_info, std::any value) {
+            if (!global_plugin_state) return;
+
+            auto monitor = std::any_cast<PHLMONITOR>(value);
+            if (!monitor) return;
+
+            global_plugin_state->on_monitor_frame(monitor->m_id);
+            global_plugin_state->event_stream.flush();
+            if (!global_plugin_state->pending_bar_frames.empty()) {
+                global_plugin_state->rendering_monitor = monitor->m_id;
+            }
+        });
 
-                try_update_hovered_region_state();
+        static auto render = HyprlandAPI::registerCallbackDynamic(global_plugin_state->handle, "render", [](void* handle, SCallbackInfo& callback_info, std::any value) {
+            if (!global_plugin_state || global_plugin_state->pending_bar_frames.empty()) return;
+
+            if (std::any_cast<eRenderStage>(value) == RENDER_POST) {
+                global_plugin_state->trace_bar_frames(global_plugin_state->rendering_monitor);
             }
         });
 
+        global_plugin_state->hyprctl_command = HyprlandAPI::registerHyprCtlCommand(global_plugin_state->handle, SHyprCtlCommand{
+            .name = "hotspots",
+            .exact = false,
+            .fn = hyprctl_hotspots,
+        });
+
         debug_file = fopen("/tmp/hypr-hotspots.log", "a");
         if (debug_file) {
             fprintf(debug_file, "Registered all callbacks\n");
@@ -977,12 +4385,14 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle)
             fclose(debug_file);
         }
 
-        // Start timer thread last
-        global_plugin_state->initialize_timer_thread();
+        // Start timers last
+        global_plugin_state->initialize_timers();
+        global_plugin_state->workers.start();
+        global_plugin_state->refresh_activity();
 
         debug_file = fopen("/tmp/hypr-hotspots.log", "a");
         if (debug_file) {
-            fprintf(debug_file, "Started timer thread\n");
+            fprintf(debug_file, "Started timers\n");
             fflush(debug_file);
             fclose(debug_file);
         }
@@ -1026,8 +4436,13 @@ APICALL EXPORT void PLUGIN_EXIT()
     }
 }
 
+bool HoverRegion::allows_show() const
+{
+    return bind ? allow_show : global_plugin_state->allow_show_waybar;
+}
+
 // Now implement the is_in_leave_area method after PluginState is fully defined
-bool WaybarRegion::is_in_leave_area(int32_t px, int32_t py) const {
+bool HoverRegion::is_in_leave_area(int32_t px, int32_t py) const {
     // Use cached values instead of expensive config calls
     int32_t leave_x = x - leave_expand_left;
     int32_t leave_y = y - leave_expand_up;
@@ -1037,7 +4452,7 @@ bool WaybarRegion::is_in_leave_area(int32_t px, int32_t py) const {
     return px >= leave_x && px <= leave_x + leave_width && py >= leave_y && py <= leave_y + leave_height;
 }
 
-void WaybarRegion::update_leave_area_cache() {
+void HoverRegion::update_leave_area_cache() {
     // Fix these to use hypr_hotspots instead of hypr_waybar
     leave_expand_left = static_cast<int32_t>(*static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:leave_expand_left")->getDataStaticPtr()));
     leave_expand_right = static_cast<int32_t>(*static_cast<const Hyprlang::INT*>(*HyprlandAPI::getConfigValue(global_plugin_state->handle, "plugin:hypr_hotspots:leave_expand_right")->getDataStaticPtr()));
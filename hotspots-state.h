@@ -0,0 +1,92 @@
+/*
+ * Layout of the hotspot state block hypr-hotspots publishes in shared memory,
+ * for status bars and scripts that poll it instead of asking the compositor.
+ *
+ * The block is the POSIX shared memory object
+ *   /hypr-hotspots-$HYPRLAND_INSTANCE_SIGNATURE   (/dev/shm/hypr-hotspots-...)
+ * created by the plugin when `state_snapshot` is on. Map it read-only and call
+ * hotspots_state_read() as often as you like: it takes no locks and makes no
+ * syscalls. The plugin only writes when something changed, from the
+ * compositor's main thread, under a sequence lock.
+ *
+ * All times are CLOCK_MONOTONIC nanoseconds. Strings are NUL-terminated and
+ * truncated to fit. Readers should check magic, version and size first.
+ */
+#ifndef HOTSPOTS_STATE_H
+#define HOTSPOTS_STATE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define HOTSPOTS_STATE_MAGIC 0x54534848u /* "HHST" */
+#define HOTSPOTS_STATE_VERSION 1
+#define HOTSPOTS_STATE_MAX_MONITORS 8
+#define HOTSPOTS_STATE_MAX_BARS 16
+#define HOTSPOTS_STATE_NAME_SIZE 64
+
+enum hotspots_bar_state
+{
+    HOTSPOTS_BAR_HIDDEN = 0,
+    HOTSPOTS_BAR_SHOWING = 1, /* Show requested, waiting for the surface to map */
+    HOTSPOTS_BAR_SHOWN = 2,
+    HOTSPOTS_BAR_HIDING = 3,  /* Hide requested, waiting for the surface to unmap */
+};
+
+/* Bits of hotspots_state.flags */
+enum
+{
+    HOTSPOTS_STATE_IDLE = 1u << 0,         /* No region can fire, input hooks are off */
+    HOTSPOTS_STATE_SHOW_ALLOWED = 1u << 1, /* toggle_bind allows showing bars */
+};
+
+struct hotspots_state_monitor
+{
+    int32_t id;                  /* Hyprland monitor ID */
+    uint32_t hovered_count;      /* Regions under the cursor */
+    uint8_t in_enter_area;       /* Cursor is in a bar region's enter area */
+    uint8_t in_leave_area;       /* ...or anywhere in its leave area */
+    uint8_t reserved[6];
+    uint64_t hide_deadline_ns;   /* When this monitor's bars hide, 0 = no hide pending */
+    uint64_t reveal_deadline_ns; /* When a workspace-change reveal ends, 0 = none */
+    char name[HOTSPOTS_STATE_NAME_SIZE];
+    char hovered[HOTSPOTS_STATE_NAME_SIZE]; /* Highest-ranked hovered region, "" = none */
+};
+
+struct hotspots_state_bar
+{
+    int32_t monitor_id;
+    int32_t pid;                 /* 0 = not seen yet */
+    uint32_t state;              /* enum hotspots_bar_state */
+    uint32_t want_visible;       /* What the plugin is driving the bar towards */
+    char name[HOTSPOTS_STATE_NAME_SIZE]; /* "process@monitor" */
+};
+
+struct hotspots_state
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;               /* sizeof(struct hotspots_state) */
+    uint32_t sequence;           /* Odd while the plugin is writing */
+    uint64_t updated_ns;
+    uint32_t flags;
+    int32_t cursor_monitor;      /* -1 = unknown */
+    uint32_t monitor_count;
+    uint32_t bar_count;
+    struct hotspots_state_monitor monitors[HOTSPOTS_STATE_MAX_MONITORS];
+    struct hotspots_state_bar bars[HOTSPOTS_STATE_MAX_BARS];
+};
+
+/* Copies a consistent snapshot of *shared into *out, retrying while a write
+ * is in progress. */
+static inline void hotspots_state_read(const struct hotspots_state* shared, struct hotspots_state* out)
+{
+    uint32_t before, after;
+    do {
+        before = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+        memcpy(out, (const void*)shared, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&shared->sequence, __ATOMIC_RELAXED);
+    } while ((before & 1u) || before != after);
+}
+
+#endif